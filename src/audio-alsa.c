@@ -28,15 +28,27 @@
 
 #include "audio.h"
 #include "preprocess.h"
+#include "framer.h"
 #include "keypressed.h"
+#include "vad.h"
 
 signed short rec_level, stop_level, silence_level;
+int frag_size = FRAG_SIZE;
+int speech_onset_hops = ( MS_TO_BYTES( SPEECH_ONSET_MS ) + OFFSET - 1 ) / OFFSET;
+int silence_hangover_hops = ( MS_TO_BYTES( SILENCE_HANGOVER_MS ) + OFFSET - 1 ) / OFFSET;
 int fd_audio;
 char *dev_audio;
 
 static snd_pcm_t *capture = NULL;
 static int is_open = 0;
 
+/*****
+ * monotonic capture time of the last sample returned by readAudio(),
+ * taken from the ALSA high resolution time stamp if the driver provides one
+ *****/
+static struct timespec capture_time;
+static int has_htstamp = 0;
+
 /********************************************************************************
  * set name of audio device
  ********************************************************************************/
@@ -113,6 +125,7 @@ int openAudio(  )
 {
     int ret;
     snd_pcm_hw_params_t *hw_params;
+    snd_pcm_sw_params_t *sw_params;
 
     if ( !dev_audio ) return AUDIO_ERR;
 
@@ -137,6 +150,14 @@ int openAudio(  )
         goto out_err;
     }
 
+    /***** ask for monotonic high resolution time stamps (not fatal if unsupported) */
+
+    snd_pcm_sw_params_alloca( &sw_params );
+    has_htstamp = snd_pcm_sw_params_current( capture, sw_params ) == 0 &&
+        snd_pcm_sw_params_set_tstamp_mode( capture, sw_params, SND_PCM_TSTAMP_ENABLE ) == 0 &&
+        snd_pcm_sw_params_set_tstamp_type( capture, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC ) == 0 &&
+        snd_pcm_sw_params( capture, sw_params ) == 0;
+
     ret = snd_pcm_prepare( capture );
     if ( ret < 0 )
     {
@@ -171,9 +192,39 @@ int readAudio( void *buf, size_t size )
     int ret = snd_pcm_readi( capture, buf, size / 2 );
     if ( ret < 0 ) return ret;
     if ( ret != size / 2 ) return -1;
+
+    /*****
+     * the time stamp belongs to the current hardware position,
+     * 'avail' frames have been captured since the last sample we got
+     *****/
+    {
+        snd_pcm_uframes_t avail;
+        snd_htimestamp_t tstamp;
+
+        if ( has_htstamp && snd_pcm_htimestamp( capture, &avail, &tstamp ) == 0 &&
+             ( tstamp.tv_sec != 0 || tstamp.tv_nsec != 0 ) )
+        {
+            long long ns = tstamp.tv_sec * 1000000000LL + tstamp.tv_nsec -
+                ( long long )avail * 1000000000LL / RATE;
+            capture_time.tv_sec = ns / 1000000000LL;
+            capture_time.tv_nsec = ns % 1000000000LL;
+        }
+        else
+            clock_gettime( CLOCK_MONOTONIC, &capture_time );
+    }
+
     return size;
 }
 
+/********************************************************************************
+ * monotonic capture time of the last block returned by readAudio()
+ ********************************************************************************/
+
+void getCaptureTime( struct timespec *ts )
+{
+    *ts = capture_time;
+}
+
 /********************************************************************************
  * get maximum value of a block of recorded audio data
  ********************************************************************************/
@@ -184,11 +235,11 @@ int getBlockMax(  )
      * buffer of size 'frag_size' that contains (raw) data which
      *****/
 
-    unsigned char buffer[FRAG_SIZE];
+    unsigned char buffer[frag_size];
     int ret, i;
 
-    ret = snd_pcm_readi( capture, buffer, FRAG_SIZE / 2 );
-    if ( ret != FRAG_SIZE / 2 )
+    ret = snd_pcm_readi( capture, buffer, frag_size / 2 );
+    if ( ret != frag_size / 2 )
     {
         if ( ret < 0 ) fprintf( stderr, "Capture error: %s\n", snd_strerror( ret ) );
         else           fprintf( stderr, "Underrun!\n" );
@@ -198,7 +249,7 @@ int getBlockMax(  )
     /***** retrieve max value */
 
     signed short value, max = 0;
-    for ( i = 0; i < FRAG_SIZE / 2; i += 2 )
+    for ( i = 0; i < frag_size - 1; i += 2 )
     {
         value = abs( ( signed short )( buffer[i] | ( buffer[i + 1] << 8 ) ) );
         if ( value > max ) max = value;
@@ -211,54 +262,67 @@ int getBlockMax(  )
  * estimate channel characteristic (channel mean vector)
  ********************************************************************************/
 
+static void addToChannelMean( const Preprocessor *pp, float *frames, int n )
+{
+    float feat_vectors[FRAME_BLOCK * FEAT_VEC_SIZE]; /***** preprocessed feature vectors */
+    int frameI, i;
+
+    preprocessFrames( pp, n, frames, feat_vectors );
+
+    for ( frameI = 0; frameI < n; frameI++ )
+        for ( i = 0; i < FEAT_VEC_SIZE; i++ )
+            channel_mean[i] += feat_vectors[frameI * FEAT_VEC_SIZE + i];
+}
+
 int calculateChannelMean(  )
 {
-    float frame[FFT_SIZE];            /***** data containers used for fft calculation */
-    int frames_N;                     /***** number of whole (overlapping) frames in current waveform buffer */
-    int frameI, i;                    /***** counter variables */
-    float feat_vector[FEAT_VEC_SIZE]; /***** preprocessed feature vector */
+    float frames[FRAME_BLOCK * FFT_SIZE]; /***** data containers used for fft calculation */
+    int frames_N = 0;                     /***** number of whole (overlapping) frames seen so far */
+    int n = 0;                            /***** number of frames waiting in 'frames' */
+    int fragI, i;                         /***** counter variables */
     int N = 100;
-    unsigned char buffer[N * FRAG_SIZE], *b;
+    unsigned char buffer[FRAG_SIZE];
+    Framer framer;
 
-    memset( channel_mean, 0, sizeof( channel_mean ) );
+    /***** the shared context has no channel mean to substract */
+    const Preprocessor *pp = defaultPreprocessor(  );
 
-    for ( b = buffer, i = 0; i < N; i++, b += FRAG_SIZE )
-        if ( snd_pcm_readi( capture, b, FRAG_SIZE / 2 ) != FRAG_SIZE / 2 )
-            return AUDIO_ERR;
-
-    /***** do preprocessing and calculate mean vector */
-    initPreprocess(  );
-    do_mean_sub = 0;
+    memset( channel_mean, 0, sizeof( channel_mean ) );
 
-    /*****
-     * number of frames that can be extracted from the current amount
-     * of audio data
-     *****/
-    frames_N = ( N * FRAG_SIZE - FFT_SIZE_CHAR ) / OFFSET + 1;
+    if ( pp == NULL || !initFramer( &framer, FRAG_SIZE, pp->hamming_window ) )
+        return AUDIO_ERR;
 
-    /***** extract these frames: */
+    /***** extract the frames of each fragment as soon as it is read */
 
-    for ( frameI = 0; frameI < frames_N; frameI++ )
+    for ( fragI = 0; fragI < N; fragI++ )
     {
-    /***** gather frame */
+        if ( snd_pcm_readi( capture, buffer, FRAG_SIZE / 2 ) != FRAG_SIZE / 2 )
+        {
+            endFramer( &framer );
+            return AUDIO_ERR;
+        }
 
-        for ( i = 0; i < FFT_SIZE; i++ )
-            frame[i] =
-                ( ( float )
-                  ( ( signed short )( buffer[frameI * OFFSET + 2 * i] |
-                                      ( buffer[frameI * OFFSET + 2 * i + 1] <<
-                                        8 ) ) ) ) * hamming_window[i];
+        framerPush( &framer, buffer, FRAG_SIZE );
 
-        preprocessFrame( frame, feat_vector );
+        /***** preprocess the frames in blocks */
 
-        for ( i = 0; i < FEAT_VEC_SIZE; i++ ) channel_mean[i] += feat_vector[i];
+        while ( framerFrame( &framer, frames + n * FFT_SIZE ) )
+        {
+            frames_N++;
+            if ( ++n == FRAME_BLOCK )
+            {
+                addToChannelMean( pp, frames, n );
+                n = 0;
+            }
+        }
     }
+    addToChannelMean( pp, frames, n );
 
     for ( i = 0; i < FEAT_VEC_SIZE; i++ ) channel_mean[i] /= frames_N;
 
     /***** cleanup */
 
-    endPreprocess(  );
+    endFramer( &framer );
 
     return AUDIO_OK;
 }
@@ -326,43 +390,45 @@ int playUtterance( unsigned char *wav, int length )
 
 unsigned char *getUtterance( int *length )
 {
-    int i;
-    signed short value, max = 0;
+    int i, n;
 
-  /***** set prefetch buffer size to 5, and allocate memory */
+    Vad vad;
 
-    int prefetch_N = 5;
-    int prefetch_pos = 0;
-    unsigned char prefetch_buf[FRAG_SIZE * prefetch_N];
-    void *prefetch = prefetch_buf;
+  /***** set prefetch buffer size to (at least) PREFETCH_SIZE bytes, and allocate memory */
 
-    int count = 0;
+    int prefetch_N = ( PREFETCH_SIZE + frag_size - 1 ) / frag_size;
+    int prefetch_pos = 0;
+    unsigned char prefetch[prefetch_N * frag_size];
 
   /***** space for one audio block */
 
-    unsigned char buffer_raw[FRAG_SIZE];
+    unsigned char buffer_raw[frag_size];
 
   /***** store whole wav data in a queue-like buffer */
 
     struct Buffer {
-        unsigned char buffer[FRAG_SIZE];
         struct Buffer *next;
+        int length;
+        unsigned char buffer[];
     };
 
     int nr_of_blocks = 0;
+    int total_length = 0;
 
     struct Buffer *first = NULL;
     struct Buffer *last = NULL;
 
     unsigned char *return_buffer;
 
+    if ( !initVad( &vad, frag_size ) ) return NULL;
+
     initKeyPressed(  );
 
-    memset( prefetch_buf, 0x00, sizeof( prefetch_buf ) );
+    memset( prefetch, 0x00, sizeof( prefetch ) );
 
   /***** prefetch data in a circular buffer, and check it for speech content */
 
-    while ( count < CONSECUTIVE_SPEECH_BLOCKS_THRESHOLD )
+    do
     {
         if ( keyPressed(  ) )
         {
@@ -370,37 +436,25 @@ unsigned char *getUtterance( int *length )
             goto getUtteranceReturn;
         }
 
-        /* fprintf(stderr, "%d ", fgetc_unlocked(stdin)); */
-
-        if ( snd_pcm_readi( capture, buffer_raw, FRAG_SIZE / 2 ) != FRAG_SIZE / 2 )
+        if ( snd_pcm_readi( capture, buffer_raw, frag_size / 2 ) != frag_size / 2 )
         {
             return_buffer = NULL;
             goto getUtteranceReturn;
         }
 
-        memcpy( ( prefetch + prefetch_pos * ( FRAG_SIZE ) ), buffer_raw, FRAG_SIZE );
+        memcpy( prefetch + prefetch_pos * frag_size, buffer_raw, frag_size );
         prefetch_pos = ( prefetch_pos + 1 ) % prefetch_N;
-
-    /***** check for speech */
-
-        max = 0;
-        for ( i = 0; i < FRAG_SIZE / 2 - 1; i += 2 )
-        {
-            value = abs( ( signed short )( buffer_raw[i] | ( buffer_raw[i + 1] << 8 ) ) );
-            if ( value > max )
-                max = value;
-        }
-        if ( max > rec_level ) count++;
-        else                   count = 0;
     }
+    while ( !detectSpeech( &vad, buffer_raw, frag_size ) );
 
   /***** store prefetch buffer in queue and do recording until level falls below threshold */
 
     for ( i = prefetch_pos; i < prefetch_pos + prefetch_N; i++ )
     {
-        struct Buffer *data = ( struct Buffer * )malloc( sizeof( struct Buffer ) );
+        struct Buffer *data = ( struct Buffer * )malloc( sizeof( struct Buffer ) + frag_size );
 
-        memcpy( data->buffer, prefetch + ( i % prefetch_N ) * FRAG_SIZE, FRAG_SIZE );
+        memcpy( data->buffer, prefetch + ( i % prefetch_N ) * frag_size, frag_size );
+        data->length = frag_size;
         data->next = NULL;
         nr_of_blocks++;
 
@@ -409,10 +463,10 @@ unsigned char *getUtterance( int *length )
         last = data;
     }
 
-    count = 0;
-    while ( count < CONSECUTIVE_NONSPEECH_BLOCKS_THRESHOLD )
+    resetVad( &vad );
+    do
     {
-        struct Buffer *data = ( struct Buffer * )malloc( sizeof( struct Buffer ) );
+        struct Buffer *data;
 
         if ( keyPressed(  ) )
         {
@@ -420,43 +474,43 @@ unsigned char *getUtterance( int *length )
             goto getUtteranceReturn;
         }
 
-        if ( snd_pcm_readi( capture, data->buffer, FRAG_SIZE / 2 ) != FRAG_SIZE / 2 )
+        data = ( struct Buffer * )malloc( sizeof( struct Buffer ) + frag_size );
+        if ( snd_pcm_readi( capture, data->buffer, frag_size / 2 ) != frag_size / 2 )
         {
             free( data );
             return_buffer = NULL;
             goto getUtteranceReturn;
         }
+        data->length = frag_size;
         data->next = NULL;
         nr_of_blocks++;
 
         if ( last != NULL ) last->next = data;
         last = data;
 
-    /***** check for nonspeech */
+    /***** check for nonspeech, the utterance ends right after the silence hangover */
 
-        max = 0;
-        for ( i = 0; i < FRAG_SIZE / 2 - 1; i += 2 )
-        {
-            value = abs( ( signed short )( data->buffer[i] | ( data->buffer[i + 1] << 8 ) ) );
-            if ( value > max ) max = value;
-        }
-        if ( max < stop_level ) count++;
-        else                    count = 0;
+        n = detectSilence( &vad, data->buffer, frag_size );
+        if ( n > 0 ) data->length = n;
     }
+    while ( n == 0 );
 
   /***** assemble data into one buffer, return it */
 
-    return_buffer = ( unsigned char * )malloc( nr_of_blocks * FRAG_SIZE );
+    {
+        struct Buffer *tmp_buffer;
 
-    *length = nr_of_blocks * FRAG_SIZE;
+        for ( tmp_buffer = first; tmp_buffer != NULL; tmp_buffer = tmp_buffer->next )
+            total_length += tmp_buffer->length;
 
-    {
-        struct Buffer *tmp_buffer = first;
+        return_buffer = ( unsigned char * )malloc( total_length );
+        *length = total_length;
 
-        for ( i = 0; i < nr_of_blocks; i++ )
+        total_length = 0;
+        for ( tmp_buffer = first; tmp_buffer != NULL; tmp_buffer = tmp_buffer->next )
         {
-            memcpy( return_buffer + ( i * FRAG_SIZE ), tmp_buffer->buffer, FRAG_SIZE );
-            tmp_buffer = tmp_buffer->next;
+            memcpy( return_buffer + total_length, tmp_buffer->buffer, tmp_buffer->length );
+            total_length += tmp_buffer->length;
         }
     }
 
@@ -469,6 +523,7 @@ unsigned char *getUtterance( int *length )
         free( tmp_buffer );
     }
 
+    endVad( &vad );
     endKeyPressed(  );
     return return_buffer;
 }
@@ -479,49 +534,57 @@ unsigned char *getUtterance( int *length )
 
 float **preprocessUtterance( unsigned char *wav, int wav_length, int *prep_length )
 {
-    float frame[FFT_SIZE];            /***** data containers used for fft calculation */
-    int frames_N;                     /***** number of whole (overlapping) frames in current waveform buffer */
-    int frameI, i;                    /***** counter variables */
-    float feat_vector[FEAT_VEC_SIZE]; /***** preprocessed feature vector */
+    float frames[FRAME_BLOCK * FFT_SIZE];            /***** data containers used for fft calculation */
+    int frames_N;                                    /***** number of whole (overlapping) frames in current waveform buffer */
+    int frameI, k, n;                                /***** counter variables, frames preprocessed in one go */
+    float feat_vectors[FRAME_BLOCK * FEAT_VEC_SIZE]; /***** preprocessed feature vectors */
+
+    int pushed = 0;                   /***** amount of audio data handed to the framer */
+    Framer framer;
 
     float **return_buffer;
 
-    initPreprocess(  );
+    const Preprocessor *pp = defaultPreprocessor(  );
+
+    if ( pp == NULL || !initFramer( &framer, FRAG_SIZE, pp->hamming_window ) )
+    {
+        *prep_length = 0;
+        return NULL;
+    }
 
     /*****
      * number of frames that can be extracted from the current amount
      * of audio data
      *****/
 
-    frames_N = ( wav_length - FFT_SIZE_CHAR ) / OFFSET + 1;
+    frames_N = wav_length < FFT_SIZE_CHAR ? 0 : ( wav_length - FFT_SIZE_CHAR ) / OFFSET + 1;
     return_buffer = ( float ** )malloc( sizeof( float * ) * frames_N );
     *prep_length = frames_N;
 
     /***** extract these frames: */
 
-    for ( frameI = 0; frameI < frames_N; frameI++ )
+    for ( frameI = 0; frameI < frames_N; frameI += n )
     {
-    /***** gather frame */
+    /***** gather a block of frames, feeding the framer as much audio data as it takes */
 
-        for ( i = 0; i < FFT_SIZE; i++ )
-            frame[i] =
-                ( ( float )
-                  ( ( signed short )( wav[frameI * OFFSET + 2 * i] |
-                                      ( wav[frameI * OFFSET + 2 * i + 1] <<
-                                        8 ) ) ) ) * hamming_window[i];
+        n = frames_N - frameI < FRAME_BLOCK ? frames_N - frameI : FRAME_BLOCK;
 
-        preprocessFrame( frame, feat_vector );
+        for ( k = 0; k < n; k++ )
+            while ( !framerFrame( &framer, frames + k * FFT_SIZE ) )
+                pushed += framerPush( &framer, wav + pushed, wav_length - pushed );
 
-        for ( i = 0; i < FEAT_VEC_SIZE; i++ )
-            feat_vector[i] -= channel_mean[i];
+        preprocessFrames( pp, n, frames, feat_vectors );
 
-        return_buffer[frameI] = ( float * )malloc( sizeof( float ) * FEAT_VEC_SIZE );
-        memcpy( return_buffer[frameI], feat_vector, sizeof( float ) * FEAT_VEC_SIZE );
+        for ( k = 0; k < n; k++ )
+        {
+            return_buffer[frameI + k] = ( float * )malloc( sizeof( float ) * FEAT_VEC_SIZE );
+            memcpy( return_buffer[frameI + k], feat_vectors + k * FEAT_VEC_SIZE, sizeof( float ) * FEAT_VEC_SIZE );
+        }
     }
 
     /***** cleanup */
 
-    endPreprocess(  );
+    endFramer( &framer );
 
     return ( return_buffer );
 }
@@ -0,0 +1,741 @@
+/***************************************************************************
+                          audio-file.c  -  read audio data from a file,
+                                           a FIFO or stdin
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/********************************************************************************
+ * Audio backend without sound hardware: the "audio device" is the name of
+ * a file or FIFO, or "-" for stdin. Prefixed with "paced:" the data is
+ * delivered in real time (one block every frag_size / 2 / RATE seconds),
+ * otherwise as fast as the program takes it.
+ *
+ * The data is either a WAV file (16 bit PCM, mono, RATE Hz; anything
+ * else is refused) or raw 16 bit little endian samples at RATE Hz.
+ *
+ * At the end of the input a bit of silence is appended, so that an
+ * utterance that is still being recorded ends normally. After that
+ * readAudio() returns 0.
+ *
+ * Regular files are opened anew by each openAudio(). A FIFO or stdin
+ * cannot be reopened and is kept open, so the data just continues.
+ * There is no playback device, playUtterance() discards the data.
+ ********************************************************************************/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "audio.h"
+#include "preprocess.h"
+#include "framer.h"
+#include "keypressed.h"
+#include "vad.h"
+
+signed short rec_level, stop_level, silence_level;
+int frag_size = FRAG_SIZE;
+int speech_onset_hops = ( MS_TO_BYTES( SPEECH_ONSET_MS ) + OFFSET - 1 ) / OFFSET;
+int silence_hangover_hops = ( MS_TO_BYTES( SILENCE_HANGOVER_MS ) + OFFSET - 1 ) / OFFSET;
+int fd_audio = -1;
+char *dev_audio;
+
+static int is_open = 0;
+
+/*****
+ * path       name of the input ("-" = stdin), part of dev_audio
+ * paced      deliver the data in real time
+ * keep_open  the input can't be reopened (FIFO, stdin)
+ *****/
+static const char *path;
+static int paced = 0;
+static int keep_open = 0;
+
+/*****
+ * state of the input:
+ *
+ * ahead        bytes read while looking for a WAV header
+ *              that turned out to be raw audio data
+ * data_left    bytes left in the WAV data chunk (-1 = up to the end of the input)
+ * at_end       end of the input has been reached
+ * padding      bytes of silence still to be delivered after the end
+ *****/
+static unsigned char ahead[12];
+static int ahead_N = 0, ahead_pos = 0;
+static long long data_left = -1;
+static int at_end = 0;
+static int padding = 0;
+
+/*****
+ * monotonic start time of the input and capture time of the last
+ * block returned by readAudio(), position = bytes delivered since then
+ *****/
+static struct timespec start_time;
+static struct timespec capture_time;
+static long long position = 0;
+
+/********************************************************************************
+ * set name of audio device
+ ********************************************************************************/
+
+void setAudio( char *dev )
+{
+    if ( !dev ) return;
+    if ( dev_audio ) free( dev_audio );
+    dev_audio = strdup( dev );
+
+    /***** a new input, forget about the old one */
+
+    if ( fd_audio >= 0 && fd_audio != STDIN_FILENO ) close( fd_audio );
+    fd_audio = -1;
+    path = NULL;
+    is_open = 0;
+}
+
+/********************************************************************************
+ * deselect any selected audio device
+ ********************************************************************************/
+
+void noAudio(  )
+{
+    if ( !dev_audio ) return;
+    if ( is_open ) closeAudio(  );
+    if ( fd_audio >= 0 && fd_audio != STDIN_FILENO ) close( fd_audio );
+    fd_audio = -1;
+    path = NULL;
+    free( dev_audio );
+    dev_audio = NULL;
+}
+
+/********************************************************************************
+ * return name of audio device
+ ********************************************************************************/
+
+char *getAudio(  )
+{
+    return dev_audio;
+}
+
+/********************************************************************************
+ * check whether device name has been set
+ ********************************************************************************/
+
+int audioOK(  )
+{
+    return dev_audio ? AUDIO_OK : AUDIO_ERR;
+}
+
+/********************************************************************************
+ * check audio capabilities and initialize audio
+ ********************************************************************************/
+
+int initAudio(  )
+{
+    if ( !dev_audio ) return AUDIO_ERR;
+
+    paced = strncmp( dev_audio, "paced:", 6 ) == 0;
+    path = paced ? dev_audio + 6 : dev_audio;
+
+    if ( strcmp( path, "-" ) != 0 && access( path, R_OK ) != 0 )
+    {
+        fprintf( stderr, "Can't read audio input %s: %s\n", path, strerror( errno ) );
+        return AUDIO_ERR;
+    }
+
+    return AUDIO_OK;
+}
+
+/********************************************************************************
+ * find list of available audio devices
+ ********************************************************************************/
+
+AudioDevices *scanAudioDevices(  )
+{
+    AudioDevices *devices;
+
+    devices = malloc( sizeof( AudioDevices ) );
+    devices->name = malloc( ( sizeof( char * ) ) );
+    devices->name[0] = strdup( "-" );
+    devices->count = 1;
+    return devices;
+}
+
+/********************************************************************************
+ * read up to 'size' bytes of the input, returns the number of bytes read
+ * (less than 'size' only at the end of the input) or -1 on error
+ ********************************************************************************/
+
+static int readInput( unsigned char *buf, int size )
+{
+    int got = 0, ret;
+
+    /***** bytes read ahead come first */
+
+    while ( got < size && ahead_pos < ahead_N ) buf[got++] = ahead[ahead_pos++];
+
+    if ( data_left >= 0 && size - got > data_left ) size = got + data_left;
+
+    while ( got < size )
+    {
+        ret = read( fd_audio, buf + got, size - got );
+        if ( ret < 0 && errno == EINTR ) continue;
+        if ( ret < 0 )
+        {
+            fprintf( stderr, "Audio input read error: %s\n", strerror( errno ) );
+            return -1;
+        }
+        if ( ret == 0 ) break;
+
+        got += ret;
+        if ( data_left >= 0 ) data_left -= ret;
+    }
+
+    return got;
+}
+
+/********************************************************************************
+ * skip 'size' bytes of the input (which may not be seekable)
+ ********************************************************************************/
+
+static int skipInput( long long size )
+{
+    unsigned char buf[256];
+    int n;
+
+    while ( size > 0 )
+    {
+        n = size < sizeof( buf ) ? size : sizeof( buf );
+        if ( readInput( buf, n ) != n ) return AUDIO_ERR;
+        size -= n;
+    }
+    return AUDIO_OK;
+}
+
+/********************************************************************************
+ * look for a WAV header at the start of the input and check its format,
+ * anything else is taken as raw audio data
+ ********************************************************************************/
+
+#define LE16(p) ( ( p )[0] | ( p )[1] << 8 )
+#define LE32(p) ( ( unsigned long )LE16( p ) | ( unsigned long )LE16( ( p ) + 2 ) << 16 )
+
+static int readHeader(  )
+{
+    unsigned char riff[12], chunk[8], fmt[16];
+    unsigned long size;
+    int got;
+
+    ahead_N = ahead_pos = 0;
+    data_left = -1;
+
+    if ( ( got = readInput( riff, sizeof( riff ) ) ) < 0 ) return AUDIO_ERR;
+
+    if ( got < sizeof( riff ) || memcmp( riff, "RIFF", 4 ) != 0 || memcmp( riff + 8, "WAVE", 4 ) != 0 )
+    {
+        memcpy( ahead, riff, got );
+        ahead_N = got;
+        return AUDIO_OK;
+    }
+
+    /***** walk through the chunks up to the data */
+
+    for ( ;; )
+    {
+        if ( readInput( chunk, sizeof( chunk ) ) != sizeof( chunk ) )
+        {
+            fprintf( stderr, "%s: no data in WAV file\n", path );
+            return AUDIO_ERR;
+        }
+        size = LE32( chunk + 4 );
+
+        if ( memcmp( chunk, "data", 4 ) == 0 )
+        {
+            /***** streaming writers don't know the size in advance */
+            data_left = ( size == 0 || size >= 0x7fffffffUL ) ? -1 : ( long long )size;
+            return AUDIO_OK;
+        }
+
+        if ( memcmp( chunk, "fmt ", 4 ) == 0 )
+        {
+            if ( size < sizeof( fmt ) || readInput( fmt, sizeof( fmt ) ) != sizeof( fmt ) )
+                return AUDIO_ERR;
+
+            /***** PCM (plain or extensible), mono, RATE Hz, 16 bit */
+
+            if ( ( LE16( fmt ) != 1 && LE16( fmt ) != 0xfffe ) || LE16( fmt + 2 ) != CHANNELS ||
+                 LE32( fmt + 4 ) != RATE || LE16( fmt + 14 ) != 16 )
+            {
+                fprintf( stderr, "%s: unsupported WAV format (%d channels, %lu Hz, %d bit), "
+                         "need 16 bit PCM, %d channel, %d Hz\n", path,
+                         LE16( fmt + 2 ), LE32( fmt + 4 ), LE16( fmt + 14 ), CHANNELS, RATE );
+                return AUDIO_ERR;
+            }
+            size -= sizeof( fmt );
+        }
+
+        /***** chunks are padded to an even size */
+
+        if ( skipInput( size + ( size & 1 ) ) != AUDIO_OK ) return AUDIO_ERR;
+    }
+}
+
+/********************************************************************************
+ * connect to audio device (recording)
+ ********************************************************************************/
+
+int openAudio(  )
+{
+    struct stat st;
+
+    if ( !dev_audio || !path ) return AUDIO_ERR;
+
+    if ( fd_audio < 0 )
+    {
+        if ( strcmp( path, "-" ) == 0 ) fd_audio = STDIN_FILENO;
+        else if ( ( fd_audio = open( path, O_RDONLY ) ) < 0 )
+        {
+            fprintf( stderr, "Failed to open audio input %s: %s\n", path, strerror( errno ) );
+            return AUDIO_ERR;
+        }
+
+        keep_open = fstat( fd_audio, &st ) != 0 || !S_ISREG( st.st_mode );
+        at_end = 0;
+
+        if ( readHeader(  ) != AUDIO_OK )
+        {
+            if ( fd_audio != STDIN_FILENO ) close( fd_audio );
+            fd_audio = -1;
+            return AUDIO_ERR;
+        }
+    }
+
+    /***** pacing starts now */
+
+    clock_gettime( CLOCK_MONOTONIC, &start_time );
+    position = 0;
+
+    is_open = 1;
+
+    return AUDIO_OK;
+}
+
+/********************************************************************************
+ * disconnect from audio device (recording)
+ ********************************************************************************/
+
+int closeAudio(  )
+{
+    if ( !is_open ) return AUDIO_OK;
+    if ( !keep_open )
+    {
+        close( fd_audio );
+        fd_audio = -1;
+    }
+    is_open = 0;
+    return ( AUDIO_OK );
+}
+
+/********************************************************************************
+ * read one block of 'size' bytes: the input padded with silence at its end,
+ * returns 'size', 0 when all of it has been delivered, or -1 on error
+ ********************************************************************************/
+
+static int readBlock( unsigned char *buf, int size )
+{
+    int got = 0;
+
+    if ( !at_end )
+    {
+        if ( ( got = readInput( buf, size ) ) < 0 ) return -1;
+        if ( got < size )
+        {
+            at_end = 1;
+            padding = silence_hangover_hops * OFFSET + 2 * frag_size;
+        }
+    }
+
+    if ( got < size )
+    {
+        if ( padding <= 0 ) return 0;
+        memset( buf + got, 0, size - got );
+        padding -= size - got;
+    }
+
+    position += size;
+
+    /*****
+     * a paced block is captured when its last sample is due,
+     * otherwise right now
+     *****/
+    if ( paced )
+    {
+        long long ns = start_time.tv_nsec + position / 2 * 1000000000LL / RATE;
+
+        capture_time.tv_sec = start_time.tv_sec + ns / 1000000000LL;
+        capture_time.tv_nsec = ns % 1000000000LL;
+        while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &capture_time, NULL ) == EINTR )
+            ;
+    }
+    else
+        clock_gettime( CLOCK_MONOTONIC, &capture_time );
+
+    return size;
+}
+
+int readAudio( void *buf, size_t size )
+{
+    if ( !is_open ) return -1;
+    return readBlock( buf, size );
+}
+
+/********************************************************************************
+ * monotonic capture time of the last block returned by readAudio()
+ ********************************************************************************/
+
+void getCaptureTime( struct timespec *ts )
+{
+    *ts = capture_time;
+}
+
+/********************************************************************************
+ * get maximum value of a block of recorded audio data
+ ********************************************************************************/
+
+int getBlockMax(  )
+{
+    /*****
+     * buffer of size 'frag_size' that contains (raw) data which
+     *****/
+
+    unsigned char buffer[frag_size];
+    int i;
+
+    if ( !is_open ) return -1;
+
+    if ( readBlock( buffer, frag_size ) != frag_size )
+    {
+        fprintf( stderr, "End of audio input!\n" );
+        return -1;
+    }
+
+    /***** retrieve max value */
+
+    signed short value, max = 0;
+    for ( i = 0; i < frag_size - 1; i += 2 )
+    {
+        value = abs( ( signed short )( buffer[i] | ( buffer[i + 1] << 8 ) ) );
+        if ( value > max ) max = value;
+    }
+
+    return max;
+}
+
+/********************************************************************************
+ * estimate channel characteristic (channel mean vector)
+ ********************************************************************************/
+
+static void addToChannelMean( const Preprocessor *pp, float *frames, int n )
+{
+    float feat_vectors[FRAME_BLOCK * FEAT_VEC_SIZE]; /***** preprocessed feature vectors */
+    int frameI, i;
+
+    preprocessFrames( pp, n, frames, feat_vectors );
+
+    for ( frameI = 0; frameI < n; frameI++ )
+        for ( i = 0; i < FEAT_VEC_SIZE; i++ )
+            channel_mean[i] += feat_vectors[frameI * FEAT_VEC_SIZE + i];
+}
+
+int calculateChannelMean(  )
+{
+    float frames[FRAME_BLOCK * FFT_SIZE]; /***** data containers used for fft calculation */
+    int frames_N = 0;                     /***** number of whole (overlapping) frames seen so far */
+    int n = 0;                            /***** number of frames waiting in 'frames' */
+    int fragI, i;                         /***** counter variables */
+    int N = 100;
+    unsigned char buffer[FRAG_SIZE];
+    Framer framer;
+
+    /***** the shared context has no channel mean to substract */
+    const Preprocessor *pp = defaultPreprocessor(  );
+
+    memset( channel_mean, 0, sizeof( channel_mean ) );
+
+    if ( pp == NULL || !initFramer( &framer, FRAG_SIZE, pp->hamming_window ) )
+        return AUDIO_ERR;
+
+    /***** extract the frames of each fragment as soon as it is read */
+
+    for ( fragI = 0; fragI < N; fragI++ )
+    {
+        if ( readBlock( buffer, FRAG_SIZE ) != FRAG_SIZE )
+        {
+            endFramer( &framer );
+            return AUDIO_ERR;
+        }
+
+        framerPush( &framer, buffer, FRAG_SIZE );
+
+        /***** preprocess the frames in blocks */
+
+        while ( framerFrame( &framer, frames + n * FFT_SIZE ) )
+        {
+            frames_N++;
+            if ( ++n == FRAME_BLOCK )
+            {
+                addToChannelMean( pp, frames, n );
+                n = 0;
+            }
+        }
+    }
+    addToChannelMean( pp, frames, n );
+
+    for ( i = 0; i < FEAT_VEC_SIZE; i++ ) channel_mean[i] /= frames_N;
+
+    /***** cleanup */
+
+    endFramer( &framer );
+
+    return AUDIO_OK;
+}
+
+/********************************************************************************
+ * return current channel mean vector
+ ********************************************************************************/
+
+const float *getChannelMean(  )
+{
+    return channel_mean;
+}
+
+/********************************************************************************
+ * playback utterance: there is no playback device, the data is discarded
+ ********************************************************************************/
+
+int playUtterance( unsigned char *wav, int length )
+{
+    return AUDIO_OK;
+}
+
+/********************************************************************************
+ * get an utterance from the audio input via auto recording
+ ********************************************************************************/
+
+unsigned char *getUtterance( int *length )
+{
+    int i, n;
+
+    Vad vad;
+
+  /***** set prefetch buffer size to (at least) PREFETCH_SIZE bytes, and allocate memory */
+
+    int prefetch_N = ( PREFETCH_SIZE + frag_size - 1 ) / frag_size;
+    int prefetch_pos = 0;
+    unsigned char prefetch[prefetch_N * frag_size];
+
+  /***** space for one audio block */
+
+    unsigned char buffer_raw[frag_size];
+
+  /***** store whole wav data in a queue-like buffer */
+
+    struct Buffer {
+        struct Buffer *next;
+        int length;
+        unsigned char buffer[];
+    };
+
+    int nr_of_blocks = 0;
+    int total_length = 0;
+
+    struct Buffer *first = NULL;
+    struct Buffer *last = NULL;
+
+    unsigned char *return_buffer;
+
+  /***** the keyboard can't be watched if the audio data comes from stdin */
+
+    int keyboard = fd_audio != STDIN_FILENO;
+
+    if ( !initVad( &vad, frag_size ) ) return NULL;
+
+    if ( keyboard ) initKeyPressed(  );
+
+    memset( prefetch, 0x00, sizeof( prefetch ) );
+
+  /***** prefetch data in a circular buffer, and check it for speech content */
+
+    do
+    {
+        if ( keyboard && keyPressed(  ) )
+        {
+            return_buffer = NULL;
+            goto getUtteranceReturn;
+        }
+
+        if ( readBlock( buffer_raw, frag_size ) != frag_size )
+        {
+            return_buffer = NULL;
+            goto getUtteranceReturn;
+        }
+
+        memcpy( prefetch + prefetch_pos * frag_size, buffer_raw, frag_size );
+        prefetch_pos = ( prefetch_pos + 1 ) % prefetch_N;
+    }
+    while ( !detectSpeech( &vad, buffer_raw, frag_size ) );
+
+  /***** store prefetch buffer in queue and do recording until level falls below threshold */
+
+    for ( i = prefetch_pos; i < prefetch_pos + prefetch_N; i++ )
+    {
+        struct Buffer *data = ( struct Buffer * )malloc( sizeof( struct Buffer ) + frag_size );
+
+        memcpy( data->buffer, prefetch + ( i % prefetch_N ) * frag_size, frag_size );
+        data->length = frag_size;
+        data->next = NULL;
+        nr_of_blocks++;
+
+        if ( first == NULL ) first = data;
+        if ( last != NULL ) last->next = data;
+        last = data;
+    }
+
+    resetVad( &vad );
+    do
+    {
+        struct Buffer *data;
+
+        if ( keyboard && keyPressed(  ) )
+        {
+            return_buffer = NULL;
+            goto getUtteranceReturn;
+        }
+
+        data = ( struct Buffer * )malloc( sizeof( struct Buffer ) + frag_size );
+        if ( readBlock( data->buffer, frag_size ) != frag_size )
+        {
+            free( data );
+            return_buffer = NULL;
+            goto getUtteranceReturn;
+        }
+        data->length = frag_size;
+        data->next = NULL;
+        nr_of_blocks++;
+
+        if ( last != NULL ) last->next = data;
+        last = data;
+
+    /***** check for nonspeech, the utterance ends right after the silence hangover */
+
+        n = detectSilence( &vad, data->buffer, frag_size );
+        if ( n > 0 ) data->length = n;
+    }
+    while ( n == 0 );
+
+  /***** assemble data into one buffer, return it */
+
+    {
+        struct Buffer *tmp_buffer;
+
+        for ( tmp_buffer = first; tmp_buffer != NULL; tmp_buffer = tmp_buffer->next )
+            total_length += tmp_buffer->length;
+
+        return_buffer = ( unsigned char * )malloc( total_length );
+        *length = total_length;
+
+        total_length = 0;
+        for ( tmp_buffer = first; tmp_buffer != NULL; tmp_buffer = tmp_buffer->next )
+        {
+            memcpy( return_buffer + total_length, tmp_buffer->buffer, tmp_buffer->length );
+            total_length += tmp_buffer->length;
+        }
+    }
+
+ getUtteranceReturn:
+
+    for ( i = 0; i < nr_of_blocks; i++ )
+    {
+        struct Buffer *tmp_buffer = first;
+        first = first->next;
+        free( tmp_buffer );
+    }
+
+    endVad( &vad );
+    if ( keyboard ) endKeyPressed(  );
+    return return_buffer;
+}
+
+/********************************************************************************
+ * preprocess an utterance
+ ********************************************************************************/
+
+float **preprocessUtterance( unsigned char *wav, int wav_length, int *prep_length )
+{
+    float frames[FRAME_BLOCK * FFT_SIZE];            /***** data containers used for fft calculation */
+    int frames_N;                                    /***** number of whole (overlapping) frames in current waveform buffer */
+    int frameI, k, n;                                /***** counter variables, frames preprocessed in one go */
+    float feat_vectors[FRAME_BLOCK * FEAT_VEC_SIZE]; /***** preprocessed feature vectors */
+
+    int pushed = 0;                   /***** amount of audio data handed to the framer */
+    Framer framer;
+
+    float **return_buffer;
+
+    const Preprocessor *pp = defaultPreprocessor(  );
+
+    if ( pp == NULL || !initFramer( &framer, FRAG_SIZE, pp->hamming_window ) )
+    {
+        *prep_length = 0;
+        return NULL;
+    }
+
+    /*****
+     * number of frames that can be extracted from the current amount
+     * of audio data
+     *****/
+
+    frames_N = wav_length < FFT_SIZE_CHAR ? 0 : ( wav_length - FFT_SIZE_CHAR ) / OFFSET + 1;
+    return_buffer = ( float ** )malloc( sizeof( float * ) * frames_N );
+    *prep_length = frames_N;
+
+    /***** extract these frames: */
+
+    for ( frameI = 0; frameI < frames_N; frameI += n )
+    {
+    /***** gather a block of frames, feeding the framer as much audio data as it takes */
+
+        n = frames_N - frameI < FRAME_BLOCK ? frames_N - frameI : FRAME_BLOCK;
+
+        for ( k = 0; k < n; k++ )
+            while ( !framerFrame( &framer, frames + k * FFT_SIZE ) )
+                pushed += framerPush( &framer, wav + pushed, wav_length - pushed );
+
+        preprocessFrames( pp, n, frames, feat_vectors );
+
+        for ( k = 0; k < n; k++ )
+        {
+            return_buffer[frameI + k] = ( float * )malloc( sizeof( float ) * FEAT_VEC_SIZE );
+            memcpy( return_buffer[frameI + k], feat_vectors + k * FEAT_VEC_SIZE, sizeof( float ) * FEAT_VEC_SIZE );
+        }
+    }
+
+    /***** cleanup */
+
+    endFramer( &framer );
+
+    return ( return_buffer );
+}
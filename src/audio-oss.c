@@ -28,14 +28,22 @@
 
 #include "audio.h"
 #include "preprocess.h"
+#include "framer.h"
 #include "keypressed.h"
+#include "vad.h"
 
 signed short rec_level, stop_level, silence_level;
+int   frag_size             = FRAG_SIZE;
+int   speech_onset_hops     = (MS_TO_BYTES(SPEECH_ONSET_MS) + OFFSET - 1) / OFFSET;
+int   silence_hangover_hops = (MS_TO_BYTES(SILENCE_HANGOVER_MS) + OFFSET - 1) / OFFSET;
 int   fd_audio;
 char *dev_audio;
 
 static int is_open = 0;
 
+/***** monotonic time at which the last block returned by readAudio() was complete */
+static struct timespec capture_time;
+
 /********************************************************************************
  * set name of audio device
  ********************************************************************************/
@@ -262,9 +270,19 @@ int readAudio( void * buf, size_t size )
     int ret = read( fd_audio, buf, size );
     if( ret < 0 ) return ret;
     if( ret != size ) return -1;
+    clock_gettime( CLOCK_MONOTONIC, &capture_time );
     return ret;
 }
 
+/********************************************************************************
+ * monotonic capture time of the last block returned by readAudio()
+ ********************************************************************************/
+
+void getCaptureTime( struct timespec *ts )
+{
+    *ts = capture_time;
+}
+
 /********************************************************************************
  * get maximum value of a block of recorded audio data
  ********************************************************************************/
@@ -275,16 +293,16 @@ int getBlockMax()
    * buffer of size 'frag_size' that contains (raw) data which
    *****/
 
-  unsigned char buffer_raw[FRAG_SIZE];
+  unsigned char buffer_raw[frag_size];
   signed short max = 0;
   int i;
 
-  if (read(fd_audio, buffer_raw, FRAG_SIZE) != FRAG_SIZE)
+  if (read(fd_audio, buffer_raw, frag_size) != frag_size)
     return -1;
 
   /***** retrieve max value */
 
-  for (i = 0; i < FRAG_SIZE/2 - 1; i += 2)
+  for (i = 0; i < frag_size - 1; i += 2)
   {
     signed short value = abs((signed short)(buffer_raw[i]|(buffer_raw[i+1]<<8)));
     if (value > max)
@@ -298,57 +316,72 @@ int getBlockMax()
  * estimate channel characteristic (channel mean vector)
  ********************************************************************************/
 
+static void addToChannelMean(const Preprocessor *pp, float *frames, int n)
+{
+  float feat_vectors[FRAME_BLOCK*FEAT_VEC_SIZE]; /***** preprocessed feature vectors */
+  int   frameI, i;
+
+  preprocessFrames(pp, n, frames, feat_vectors);
+
+  for (frameI = 0; frameI < n; frameI++)
+    for (i = 0; i < FEAT_VEC_SIZE; i++)
+      channel_mean[i] += feat_vectors[frameI*FEAT_VEC_SIZE+i];
+}
+
 int calculateChannelMean()
 {
-  float frame[FFT_SIZE];            /***** data containers used for fft calculation */
-  int   frames_N;                   /***** number of whole (overlapping) frames in current waveform buffer */
-  int   frameI, i;                  /***** counter variables */
-  float feat_vector[FEAT_VEC_SIZE]; /***** preprocessed feature vector */
+  float frames[FRAME_BLOCK*FFT_SIZE]; /***** data containers used for fft calculation */
+  int   frames_N = 0;                 /***** number of whole (overlapping) frames seen so far */
+  int   n = 0;                        /***** number of frames waiting in 'frames' */
+  int   fragI, i;                     /***** counter variables */
 
   int N = 100;
 
-  unsigned char buffer[N*FRAG_SIZE];
+  unsigned char buffer[FRAG_SIZE];
+  Framer framer;
 
-  for (i = 0; i < FEAT_VEC_SIZE; i++)
-    channel_mean[i] = 0;
+  /***** the shared context has no channel mean to substract */
 
-  for (i = 0; i < N; i++)
-    if (read(fd_audio, buffer+i*FRAG_SIZE, FRAG_SIZE) != FRAG_SIZE)
-      return AUDIO_ERR;
-
-  /***** do preprocessing and calculate mean vector */
+  const Preprocessor *pp = defaultPreprocessor();
 
-  initPreprocess();
-  do_mean_sub = 0;
+  for (i = 0; i < FEAT_VEC_SIZE; i++)
+    channel_mean[i] = 0;
 
-  /*****
-   * number of frames that can be extracted from the current amount
-   * of audio data
-   *****/
-  frames_N = (N*FRAG_SIZE-FFT_SIZE_CHAR)/OFFSET + 1;
+  if (pp == NULL || !initFramer(&framer, FRAG_SIZE, pp->hamming_window))
+    return AUDIO_ERR;
 
-  /***** extract these frames: */
+  /***** extract the frames of each fragment as soon as it is read */
 
-  for (frameI = 0; frameI < frames_N; frameI++)
+  for (fragI = 0; fragI < N; fragI++)
   {
-    /***** gather frame */
+    if (read(fd_audio, buffer, FRAG_SIZE) != FRAG_SIZE)
+    {
+      endFramer(&framer);
+      return AUDIO_ERR;
+    }
 
-    for (i = 0; i < FFT_SIZE; i++)
-      frame[i] = ((float)((signed short)(buffer[frameI*OFFSET+2*i]|(buffer[frameI*OFFSET+2*i+1]<<8)))) *
-	hamming_window[i];
+    framerPush(&framer, buffer, FRAG_SIZE);
 
-    preprocessFrame(frame, feat_vector);
+    /***** preprocess the frames in blocks */
 
-    for (i = 0; i < FEAT_VEC_SIZE; i++)
-      channel_mean[i] += feat_vector[i];
+    while (framerFrame(&framer, frames+n*FFT_SIZE))
+    {
+      frames_N++;
+      if (++n == FRAME_BLOCK)
+      {
+        addToChannelMean(pp, frames, n);
+        n = 0;
+      }
+    }
   }
+  addToChannelMean(pp, frames, n);
 
   for (i = 0; i < FEAT_VEC_SIZE; i++)
     channel_mean[i] /= frames_N;
 
   /***** cleanup */
 
-  endPreprocess();
+  endFramer(&framer);
 
   return (AUDIO_OK);
 }
@@ -413,44 +446,47 @@ int playUtterance(unsigned char *wav, int length)
 
 unsigned char *getUtterance(int *length)
 {
-  int i;
-  signed short max = 0;
+  int i, n;
 
-  /***** set prefetch buffer size to 5, and allocate memory */
+  Vad vad;
 
-  int           prefetch_N    = 5;
-  int           prefetch_pos  = 0;
-  unsigned char prefetch_buf[FRAG_SIZE*prefetch_N];
-  void         *prefetch      = prefetch_buf;
+  /***** set prefetch buffer size to (at least) PREFETCH_SIZE bytes, and allocate memory */
 
-  int count     = 0;
+  int           prefetch_N    = (PREFETCH_SIZE + frag_size - 1) / frag_size;
+  int           prefetch_pos  = 0;
+  unsigned char prefetch[prefetch_N*frag_size];
 
   /***** space for one audio block */
 
-  unsigned char buffer_raw[FRAG_SIZE];
+  unsigned char buffer_raw[frag_size];
 
   /***** store whole wav data in a queue-like buffer */
 
   struct Buffer
   {
-    unsigned char buffer[FRAG_SIZE];
     struct Buffer *next;
+    int            length;
+    unsigned char  buffer[];
   };
 
   int nr_of_blocks = 0;
+  int total_length = 0;
 
   struct Buffer *first = NULL;
   struct Buffer *last  = NULL;
 
   unsigned char *return_buffer;
 
+  if (!initVad(&vad, frag_size))
+    return NULL;
+
   initKeyPressed();
 
-  memset (prefetch_buf, 0x00, FRAG_SIZE*prefetch_N);
+  memset (prefetch, 0x00, sizeof(prefetch));
 
   /***** prefetch data in a circular buffer, and check it for speech content */
 
-  while (count < CONSECUTIVE_SPEECH_BLOCKS_THRESHOLD)
+  do
   {
     if (keyPressed())
     {
@@ -458,40 +494,25 @@ unsigned char *getUtterance(int *length)
       goto getUtteranceReturn;
     }
 
-    /* fprintf(stderr, "%d ", fgetc_unlocked(stdin)); */
-
-    if (read(fd_audio, buffer_raw, FRAG_SIZE) != FRAG_SIZE)
+    if (read(fd_audio, buffer_raw, frag_size) != frag_size)
     {
       return_buffer = NULL;
       goto getUtteranceReturn;
     }
 
-    memcpy((prefetch+prefetch_pos*(FRAG_SIZE)), buffer_raw, FRAG_SIZE);
+    memcpy(prefetch+prefetch_pos*frag_size, buffer_raw, frag_size);
     prefetch_pos = (prefetch_pos+1)%prefetch_N;
-
-    /***** check for speech */
-
-    max = 0;
-    for (i = 0; i < FRAG_SIZE/2 - 1; i += 2)
-    {
-      signed short value = abs((signed short)(buffer_raw[i]|(buffer_raw[i+1]<<8)));
-
-      if (value > max)
-	max = value;
-    }
-    if (max > rec_level)
-      count++;
-    else
-      count = 0;
   }
+  while (!detectSpeech(&vad, buffer_raw, frag_size));
 
   /***** store prefetch buffer in queue and do recording until level falls below threshold */
 
   for (i = prefetch_pos; i < prefetch_pos+prefetch_N; i++)
   {
-    struct Buffer *data = (struct Buffer *)malloc(sizeof(struct Buffer));
+    struct Buffer *data = (struct Buffer *)malloc(sizeof(struct Buffer) + frag_size);
 
-    memcpy(data->buffer, prefetch+(i%prefetch_N)*FRAG_SIZE, FRAG_SIZE);
+    memcpy(data->buffer, prefetch+(i%prefetch_N)*frag_size, frag_size);
+    data->length = frag_size;
     data->next = NULL;
     nr_of_blocks++;
 
@@ -502,10 +523,10 @@ unsigned char *getUtterance(int *length)
       first = data;
   }
 
-  count = 0;
-  while (count < CONSECUTIVE_NONSPEECH_BLOCKS_THRESHOLD)
+  resetVad(&vad);
+  do
   {
-    struct Buffer *data = (struct Buffer *)malloc(sizeof(struct Buffer));
+    struct Buffer *data;
 
     if (keyPressed())
     {
@@ -513,12 +534,14 @@ unsigned char *getUtterance(int *length)
       goto getUtteranceReturn;
     }
 
-    if (read(fd_audio, data->buffer, FRAG_SIZE) != FRAG_SIZE)
+    data = (struct Buffer *)malloc(sizeof(struct Buffer) + frag_size);
+    if (read(fd_audio, data->buffer, frag_size) != frag_size)
     {
       free(data);
       return_buffer = NULL;
       goto getUtteranceReturn;
     }
+    data->length = frag_size;
     data->next = NULL;
     nr_of_blocks++;
 
@@ -526,35 +549,30 @@ unsigned char *getUtterance(int *length)
       last->next = data;
     last = data;
 
-    /***** check for nonspeech */
+    /***** check for nonspeech, the utterance ends right after the silence hangover */
 
-    max = 0;
-    for (i = 0; i < FRAG_SIZE/2 - 1; i += 2)
-    {
-      signed short value = abs((signed short)(data->buffer[i]|(data->buffer[i+1]<<8)));
-
-      if (value > max)
-	max = value;
-    }
-    if (max < stop_level)
-      count++;
-    else
-      count = 0;
+    n = detectSilence(&vad, data->buffer, frag_size);
+    if (n > 0)
+      data->length = n;
   }
+  while (n == 0);
 
   /***** assemble data into one buffer, return it */
 
-  return_buffer = (unsigned char *)malloc(nr_of_blocks*FRAG_SIZE);
+  {
+    struct Buffer *tmp_buffer;
 
-  *length = nr_of_blocks*FRAG_SIZE;
+    for (tmp_buffer = first; tmp_buffer != NULL; tmp_buffer = tmp_buffer->next)
+      total_length += tmp_buffer->length;
 
-  {
-    struct Buffer *tmp_buffer = first;
+    return_buffer = (unsigned char *)malloc(total_length);
+    *length = total_length;
 
-    for (i = 0; i < nr_of_blocks; i++)
+    total_length = 0;
+    for (tmp_buffer = first; tmp_buffer != NULL; tmp_buffer = tmp_buffer->next)
     {
-      memcpy(return_buffer+(i*FRAG_SIZE), tmp_buffer->buffer, FRAG_SIZE);
-      tmp_buffer = tmp_buffer->next;
+      memcpy(return_buffer+total_length, tmp_buffer->buffer, tmp_buffer->length);
+      total_length += tmp_buffer->length;
     }
   }
 
@@ -567,6 +585,7 @@ unsigned char *getUtterance(int *length)
     free(tmp_buffer);
   }
 
+  endVad(&vad);
   endKeyPressed();
   return return_buffer;
 }
@@ -577,45 +596,56 @@ unsigned char *getUtterance(int *length)
 
 float **preprocessUtterance(unsigned char *wav, int wav_length, int *prep_length)
 {
-  float frame[FFT_SIZE];            /***** data containers used for fft calculation */
-  int   frames_N;                   /***** number of whole (overlapping) frames in current waveform buffer */
-  int   frameI, i;                  /***** counter variables */
-  float feat_vector[FEAT_VEC_SIZE]; /***** preprocessed feature vector */
+  float frames[FRAME_BLOCK*FFT_SIZE];            /***** data containers used for fft calculation */
+  int   frames_N;                                /***** number of whole (overlapping) frames in current waveform buffer */
+  int   frameI, k, n;                            /***** counter variables, frames preprocessed in one go */
+  float feat_vectors[FRAME_BLOCK*FEAT_VEC_SIZE]; /***** preprocessed feature vectors */
+
+  int   pushed = 0;                 /***** amount of audio data handed to the framer */
+  Framer framer;
 
   float **return_buffer;
 
-  initPreprocess();
+  const Preprocessor *pp = defaultPreprocessor();
+
+  if (pp == NULL || !initFramer(&framer, FRAG_SIZE, pp->hamming_window))
+  {
+    *prep_length = 0;
+    return NULL;
+  }
 
   /*****
    * number of frames that can be extracted from the current amount
    * of audio data
    *****/
-  frames_N = (wav_length-FFT_SIZE_CHAR)/OFFSET + 1;
+  frames_N = wav_length < FFT_SIZE_CHAR ? 0 : (wav_length-FFT_SIZE_CHAR)/OFFSET + 1;
   return_buffer = (float **)malloc(sizeof(float *)*frames_N);
   *prep_length = frames_N;
 
   /***** extract these frames: */
 
-  for (frameI = 0; frameI < frames_N; frameI++)
+  for (frameI = 0; frameI < frames_N; frameI += n)
   {
-    /***** gather frame */
+    /***** gather a block of frames, feeding the framer as much audio data as it takes */
 
-    for (i = 0; i < FFT_SIZE; i++)
-      frame[i] = ((float)((signed short)(wav[frameI*OFFSET+2*i]|(wav[frameI*OFFSET+2*i+1]<<8)))) *
-	hamming_window[i];
+    n = (frames_N-frameI < FRAME_BLOCK) ? frames_N-frameI : FRAME_BLOCK;
 
-    preprocessFrame(frame, feat_vector);
+    for (k = 0; k < n; k++)
+      while (!framerFrame(&framer, frames+k*FFT_SIZE))
+        pushed += framerPush(&framer, wav+pushed, wav_length-pushed);
 
-    for (i = 0; i < FEAT_VEC_SIZE; i++)
-      feat_vector[i] -= channel_mean[i];
+    preprocessFrames(pp, n, frames, feat_vectors);
 
-    return_buffer[frameI] = (float *)malloc(sizeof(float)*FEAT_VEC_SIZE);
-    memcpy(return_buffer[frameI], feat_vector, sizeof(float)*FEAT_VEC_SIZE);
+    for (k = 0; k < n; k++)
+    {
+      return_buffer[frameI+k] = (float *)malloc(sizeof(float)*FEAT_VEC_SIZE);
+      memcpy(return_buffer[frameI+k], feat_vectors+k*FEAT_VEC_SIZE, sizeof(float)*FEAT_VEC_SIZE);
+    }
   }
 
   /***** cleanup */
 
-  endPreprocess();
+  endFramer(&framer);
 
   return (return_buffer);
 }
@@ -18,23 +18,54 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <stddef.h>
+#include <time.h>
+
+#include "preprocess.h"   /***** RATE of the front end profile */
+
 #define CHANNELS  1
-#define RATE      16000
 #define AFMT      AFMT_S16_LE
-/***** unlimited number of fragments of size 2^11 = 256 bytes */
+/***** unlimited number of fragments of size 2^11 = 2048 bytes (2^10 at 8 kHz), i.e. 64 ms */
+#if RATE == 8000
+#define FRAG      0x7fff000a
+#else
 #define FRAG      0x7fff000b
-#define FRAG_SIZE 2048
+#endif
+#define FRAG_SIZE MS_TO_BYTES(FRAGMENT_MS)
 
 #define AUDIO_ERR 1
 #define AUDIO_OK  0
 
-#define CONSECUTIVE_SPEECH_BLOCKS_THRESHOLD    3
-#define CONSECUTIVE_NONSPEECH_BLOCKS_THRESHOLD 5
+/***** number of bytes of audio data in 'ms' milliseconds */
+#define MS_TO_BYTES(ms) ((ms) * (RATE / 1000) * 2)
+
+/********************************************************************************
+ * timing of the recording, all values can be set in the configuration file
+ * (in milliseconds):
+ *
+ * FRAGMENT_MS          size of a block of audio data read from the device
+ *                      (frag_size bytes, at least MIN_FRAGMENT_MS)
+ * SPEECH_ONSET_MS      duration of speech needed to start recording
+ *                      (speech_onset_hops hops of 10 ms)
+ * SILENCE_HANGOVER_MS  duration of silence needed to stop recording
+ *                      (silence_hangover_hops hops of 10 ms)
+ * PREFETCH_SIZE        amount of audio data (in bytes) kept in front
+ *                      of an utterance
+ ********************************************************************************/
+
+#define FRAGMENT_MS          64
+#define MIN_FRAGMENT_MS      20
+#define SPEECH_ONSET_MS      192
+#define SILENCE_HANGOVER_MS  320
+#define PREFETCH_SIZE        (5 * FRAG_SIZE)
+
+extern int frag_size;
+extern int speech_onset_hops, silence_hangover_hops;
 
 
 /********************************************************************************
- * For now, microphone input level is used to start and stop recording
- * (it would be better to do a fast spectral speech/nonspeech analysis)
+ * The microphone input level is used to start and stop recording, unless
+ * the spectral speech/nonspeech detection is switched on (see vad.h)
  *
  * rec_level      input level above which recording is started
  * stop_level     input level below which recording is stopped
@@ -58,7 +89,14 @@ int  initAudio();
 AudioDevices *scanAudioDevices();
 
 int openAudio();
+
+/*****
+  read 'size' bytes of audio data, returns 'size', or 0 at the end
+  of the input (only an input that is not a sound card has one),
+  or a negative value on error
+  *****/
 int readAudio( void * buf, size_t size );
+void getCaptureTime( struct timespec *ts );
 int getBlockMax();
 unsigned char *getUtterance(int *length);
 int playUtterance(unsigned char *wav, int length);
@@ -20,30 +20,63 @@
 
 #include <stdlib.h>
 
+/*****
+  number of items in the first block of the pool,
+  each further block doubles the size of the pool
+  *****/
+#define BB_POOL_BLOCK 64
+
 /********************************************************************************
  * initialize queue
  ********************************************************************************/
 
 void initBBQueue(BBQueue *queue)
 {
-  queue->length = 0;
-  queue->first  = NULL;
+  queue->length     = 0;
+  queue->heap       = NULL;
+  queue->heap_size  = 0;
+  queue->order      = 0;
+  queue->free_items = NULL;
+  queue->blocks     = NULL;
 };
 
 /********************************************************************************
- * reset (empty) queue
+ * reset (empty) queue, all items in it go back to the pool
  ********************************************************************************/
 
 void resetBBQueue(BBQueue *queue)
 {
-  while (queue->first != NULL)
+  while (queue->length > 0)
+    releaseBBQueueItem(queue, queue->heap[--queue->length]);
+  queue->order = 0;
+};
+
+/********************************************************************************
+ * release all memory of the queue
+ ********************************************************************************/
+
+void endBBQueue(BBQueue *queue)
+{
+  while (queue->blocks != NULL)
   {
-    BBQueueItem *tmp_item = queue->first;
-    queue->first = queue->first->next;
-    free(tmp_item);
+    BBQueueBlock *tmp_block = queue->blocks;
+    queue->blocks = queue->blocks->next;
+    free(tmp_block->items);
+    free(tmp_block);
   }
-  queue->length = 0;
-};
+  free(queue->heap);
+
+  initBBQueue(queue);
+}
+
+/********************************************************************************
+ * does item a come before item b?
+ ********************************************************************************/
+
+static int before(BBQueueItem *a, BBQueueItem *b)
+{
+  return (a->score < b->score || (a->score == b->score && a->order > b->order));
+}
 
 /********************************************************************************
  * insert an item into queue (items are sorted by increasing score!)
@@ -51,26 +84,30 @@ void resetBBQueue(BBQueue *queue)
 
 void insertItemIntoBBQueue(BBQueue *queue, BBQueueItem *item)
 {
-  if (queue->first == NULL)
-    queue->first = item;
-  else if (queue->first->score >= item->score)
+  int i, parent;
+
+  /***** make room for one more item (the heap never has to shrink) */
+
+  if (queue->length == queue->heap_size)
   {
-    item->next = queue->first;
-    queue->first = item;
+    queue->heap_size = queue->heap_size > 0 ? 2*queue->heap_size : BB_POOL_BLOCK;
+    queue->heap = (BBQueueItem **)realloc(queue->heap, sizeof(BBQueueItem *)*queue->heap_size);
   }
-  else
-  {
-    /***** find place in queue */
 
-    BBQueueItem *tmp_queue = queue->first;
+  item->order = queue->order++;
 
-    while (tmp_queue->next != NULL && tmp_queue->next->score < item->score)
-      tmp_queue = tmp_queue->next;
-    item->next = tmp_queue->next;
-    tmp_queue->next = item;
-  }
+  /***** move the item up from the last place, as long as it comes before its parent */
 
-  queue->length++;
+  i = queue->length++;
+  while (i > 0)
+  {
+    parent = (i - 1)/2;
+    if (!before(item, queue->heap[parent]))
+      break;
+    queue->heap[i] = queue->heap[parent];
+    i = parent;
+  }
+  queue->heap[i] = item;
 }
 
 /********************************************************************************
@@ -79,7 +116,27 @@ void insertItemIntoBBQueue(BBQueue *queue, BBQueueItem *item)
 
 void insertIntoBBQueue(BBQueue *queue, int pos, float score, int sample_index)
 {
-  BBQueueItem *new_item = (BBQueueItem *)malloc(sizeof(BBQueueItem));
+  BBQueueItem *new_item;
+
+  /***** take an item from the pool, add a block of items if it is empty */
+
+  if (queue->free_items == NULL)
+  {
+    BBQueueBlock *block = (BBQueueBlock *)malloc(sizeof(BBQueueBlock));
+    int i;
+
+    block->size  = queue->blocks != NULL ? 2*queue->blocks->size : BB_POOL_BLOCK;
+    block->items = (BBQueueItem *)malloc(sizeof(BBQueueItem)*block->size);
+    block->next  = queue->blocks;
+    queue->blocks = block;
+
+    for (i = 0; i < block->size; i++)
+      releaseBBQueueItem(queue, block->items + i);
+  }
+
+  new_item = queue->free_items;
+  queue->free_items = new_item->next;
+
   new_item->pos          = pos;
   new_item->score        = score;
   new_item->sample_index = sample_index;
@@ -90,15 +147,38 @@ void insertIntoBBQueue(BBQueue *queue, int pos, float score, int sample_index)
 
 /********************************************************************************
  * get the head item from the queue
+ * (it has to be inserted again or released)
  ********************************************************************************/
 
 BBQueueItem *headBBQueue(BBQueue *queue)
 {
-  BBQueueItem *retval = queue->first;
-  queue->first = queue->first->next;
-  queue->length--;
+  BBQueueItem *retval = queue->heap[0];
+  BBQueueItem *last   = queue->heap[--queue->length];
+  int i = 0, child;
+
+  /***** move the last item down from the top, as long as a child comes before it */
+
+  while ((child = 2*i + 1) < queue->length)
+  {
+    if (child + 1 < queue->length && before(queue->heap[child + 1], queue->heap[child]))
+      child++;
+    if (!before(queue->heap[child], last))
+      break;
+    queue->heap[i] = queue->heap[child];
+    i = child;
+  }
+  if (queue->length > 0)
+    queue->heap[i] = last;
 
   return(retval);
 }
 
+/********************************************************************************
+ * return an item taken from the queue to the pool
+ ********************************************************************************/
 
+void releaseBBQueueItem(BBQueue *queue, BBQueueItem *item)
+{
+  item->next = queue->free_items;
+  queue->free_items = item;
+}
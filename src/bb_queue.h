@@ -20,7 +20,12 @@
 #define BB_QUEUE_H
 
 /*****
-  a queue needed for branchNbound decoding
+  a queue needed for branchNbound decoding:
+  a binary heap of items, ordered by increasing score
+  (items with the same score: the one inserted last first)
+
+  the items are taken from a pool that only grows, they are
+  returned to it by releaseBBQueueItem() or resetBBQueue()
   *****/
 struct _BBQueueItem
 {
@@ -28,22 +33,44 @@ struct _BBQueueItem
   float score;
   int   sample_index;
 
-  struct _BBQueueItem *next;
+  unsigned int order;        /***** insertion counter, breaks ties */
+
+  struct _BBQueueItem *next; /***** next free item in the pool */
 };
 typedef struct _BBQueueItem BBQueueItem;
 
+/*****
+  a block of pool items (allocated in one go)
+  *****/
+struct _BBQueueBlock
+{
+  int size;
+  BBQueueItem *items;
+
+  struct _BBQueueBlock *next;
+};
+typedef struct _BBQueueBlock BBQueueBlock;
+
 typedef struct
 {
   int length;
 
-  BBQueueItem *first;
+  BBQueueItem **heap;  /***** heap[0] has the minimum score */
+  int heap_size;
+
+  unsigned int order;
+
+  BBQueueItem  *free_items;
+  BBQueueBlock *blocks;
 } BBQueue;
 
 void initBBQueue(BBQueue *queue);
 void resetBBQueue(BBQueue *queue);
+void endBBQueue(BBQueue *queue);
 void insertItemIntoBBQueue(BBQueue *queue, BBQueueItem *item);
 void insertIntoBBQueue(BBQueue *queue, int pos, float score, int sample_index);
 BBQueueItem *headBBQueue(BBQueue *queue);
+void releaseBBQueueItem(BBQueue *queue, BBQueueItem *item);
 
 #endif
 
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sched.h>
 #include <sys/stat.h>
 
 #include "configuration.h"
@@ -30,6 +31,42 @@
 #include "preprocess.h"
 
 #include "cvoicecontrol.h"
+#include "realtime.h"
+#include "vad.h"
+#include "trim.h"
+#include "vfr.h"
+#include "spotter.h"
+#include "model.h"
+
+/***** scheduling and memory locking of the recognizer, see realtime.h */
+
+int  capture_policy   = SCHED_OTHER;
+int  capture_priority = 0;
+char thread_cpus[T_number_of_threads][CPU_LIST_SIZE];
+int  lock_memory      = 0;
+
+/***** keyword spotting, see spotter.h */
+
+int   keyword_spotting  = 0;
+float keyword_threshold = 6;
+int   keyword_active    = 0;
+
+/***** groups of references active at start, see model.h */
+
+char start_context[CONTEXT_SIZE] = "";
+char wake_group[CONTEXT_SIZE]    = "";
+
+/***** early decision and wake word cascade, see cvoicecontrol.h */
+
+float early_margin   = 0;
+int   early_frames   = 20;
+float wake_threshold = 8;
+int   wake_time      = 5000;
+
+/***** batches of feature vectors, see cvoicecontrol.h */
+
+int frame_batch   = 0;
+int batch_latency = 100;
 
 int _mkdir( const char *p, mode_t mode )
 {
@@ -110,6 +147,20 @@ char *dataStart( char *s )
     return s;
 }
 
+/********************************************************************************
+ * copy the rest of a config line (a CPU list like "0,2-3") into 'cpus'
+ ********************************************************************************/
+
+void getCpuList( char *s, char *cpus )
+{
+    char *data = dataStart( s );
+    int len = strcspn( data, "\n" );
+
+    if( len >= CPU_LIST_SIZE ) len = CPU_LIST_SIZE - 1;
+    memcpy( cpus, data, len );
+    cpus[len] = '\0';
+}
+
 /********************************************************************************
  * load configuration
  ********************************************************************************/
@@ -149,10 +200,22 @@ int loadConfiguration(  )
         char s[l];
         char tmp_dev_audio[80];
         char tmp_dev_mixer[80];
+        char tmp_policy[80];
+        char tmp_vad[80];
+        char tmp_bank[80];
+        int fragment_ms = FRAGMENT_MS;
+        int speech_onset_ms = SPEECH_ONSET_MS;
+        int silence_hangover_ms = SILENCE_HANGOVER_MS;
 
         /* set default values here! */
 
         score_threshold = 18;
+        early_margin = 0;
+        early_frames = 20;
+        wake_threshold = 8;
+        wake_time = 5000;
+        frame_batch = 0;
+        batch_latency = 100;
         rec_level = stop_level = silence_level = 0;
 
         while( fgets( s, l, f ) != NULL )
@@ -173,8 +236,98 @@ int loadConfiguration(  )
                 sscanf( dataStart( s ), "%hd\n", &stop_level );
             else if( isParameter( s, "Silence Level" ) )
                 sscanf( dataStart( s ), "%hd\n", &silence_level );
+            else if( isParameter( s, "Fragment Size" ) )
+                sscanf( dataStart( s ), "%d\n", &fragment_ms );
+            else if( isParameter( s, "Speech Onset" ) )
+                sscanf( dataStart( s ), "%d\n", &speech_onset_ms );
+            else if( isParameter( s, "Silence Hangover" ) )
+                sscanf( dataStart( s ), "%d\n", &silence_hangover_ms );
+            else if( isParameter( s, "Voice Detection" ) )
+            {
+                if( sscanf( dataStart( s ), "%79s\n", tmp_vad ) != 1 || strcmp( tmp_vad, "level" ) == 0 )
+                    vad_mode = V_level;
+                else if( strcmp( tmp_vad, "spectral" ) == 0 )
+                    vad_mode = V_spectral;
+                else
+                    fprintf( stderr, "Invalid 'Voice Detection' in configuration file (ignored): %s",
+                             s );
+            }
+            else if( isParameter( s, "Filter Bank" ) )
+            {
+                if( sscanf( dataStart( s ), "%79s\n", tmp_bank ) != 1 )
+                    fprintf( stderr, "Invalid 'Filter Bank' in configuration file (ignored): %s", s );
+                else if( strcmp( tmp_bank, "classic" ) == 0 )
+                    filter_bank = FB_classic;
+                else if( strcmp( tmp_bank, "mel" ) == 0 )
+                    filter_bank = FB_mel;
+                else
+                    fprintf( stderr, "Invalid 'Filter Bank' in configuration file (ignored): %s", s );
+            }
+            else if( isParameter( s, "Speech SNR" ) )
+                sscanf( dataStart( s ), "%f\n", &speech_snr );
+            else if( isParameter( s, "Silence SNR" ) )
+                sscanf( dataStart( s ), "%f\n", &silence_snr );
+            else if( isParameter( s, "Trim Silence" ) )
+                sscanf( dataStart( s ), "%d\n", &trim_guard );
+            else if( isParameter( s, "Trim SNR" ) )
+                sscanf( dataStart( s ), "%f\n", &trim_snr );
+            else if( isParameter( s, "Frame Merging" ) )
+                sscanf( dataStart( s ), "%f\n", &vfr_threshold );
+            else if( isParameter( s, "Frame Batch" ) )
+                sscanf( dataStart( s ), "%d\n", &frame_batch );
+            else if( isParameter( s, "Batch Latency" ) )
+                sscanf( dataStart( s ), "%d\n", &batch_latency );
             else if( isParameter( s, "Score Threshold" ) )
                 sscanf( dataStart( s ), "%f\n", &score_threshold );
+            else if( isParameter( s, "Early Decision Margin" ) )
+                sscanf( dataStart( s ), "%f\n", &early_margin );
+            else if( isParameter( s, "Early Decision Frames" ) )
+                sscanf( dataStart( s ), "%d\n", &early_frames );
+            else if( isParameter( s, "Keyword Spotting" ) )
+                sscanf( dataStart( s ), "%d\n", &keyword_spotting );
+            else if( isParameter( s, "Keyword Threshold" ) )
+                sscanf( dataStart( s ), "%f\n", &keyword_threshold );
+            else if( isParameter( s, "Keyword Active" ) )
+                sscanf( dataStart( s ), "%d\n", &keyword_active );
+            else if( isParameter( s, "Context" ) )
+            {
+                if( sscanf( dataStart( s ), "%79[^\n]", start_context ) != 1 )
+                    start_context[0] = '\0';
+            }
+            else if( isParameter( s, "Wake Word" ) )
+            {
+                if( sscanf( dataStart( s ), "%79s\n", wake_group ) != 1 )
+                    wake_group[0] = '\0';
+            }
+            else if( isParameter( s, "Wake Threshold" ) )
+                sscanf( dataStart( s ), "%f\n", &wake_threshold );
+            else if( isParameter( s, "Wake Time" ) )
+                sscanf( dataStart( s ), "%d\n", &wake_time );
+            else if( isParameter( s, "Capture Scheduling" ) )
+            {
+                if( sscanf( dataStart( s ), "%79s\n", tmp_policy ) != 1 ||
+                    strcmp( tmp_policy, "other" ) == 0 )
+                    capture_policy = SCHED_OTHER;
+                else if( strcmp( tmp_policy, "fifo" ) == 0 )
+                    capture_policy = SCHED_FIFO;
+                else if( strcmp( tmp_policy, "rr" ) == 0 )
+                    capture_policy = SCHED_RR;
+                else
+                    fprintf( stderr, "Invalid 'Capture Scheduling' in configuration file (ignored): %s",
+                             s );
+            }
+            else if( isParameter( s, "Capture Priority" ) )
+                sscanf( dataStart( s ), "%d\n", &capture_priority );
+            else if( isParameter( s, "Record CPUs" ) )
+                getCpuList( s, thread_cpus[T_record] );
+            else if( isParameter( s, "Preprocess CPUs" ) )
+                getCpuList( s, thread_cpus[T_preprocess] );
+            else if( isParameter( s, "Recognize CPUs" ) )
+                getCpuList( s, thread_cpus[T_recognize] );
+            else if( isParameter( s, "Worker CPUs" ) )
+                getCpuList( s, thread_cpus[T_worker] );
+            else if( isParameter( s, "Lock Memory" ) )
+                sscanf( dataStart( s ), "%d\n", &lock_memory );
             else if( isParameter( s, "Channel Mean" ) )
                 sscanf( dataStart( s ), "%f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f\n",
                         channel_mean + 0, channel_mean + 1, channel_mean + 2,
@@ -204,6 +357,80 @@ int loadConfiguration(  )
             fprintf( stderr, "Invalid 'Silence Level' in configuration file!\n" );
             exit( -1 );
         }
+        if( fragment_ms < MIN_FRAGMENT_MS )
+        {
+            fprintf( stderr, "Invalid 'Fragment Size' in configuration file (minimum is %d ms)!\n",
+                     MIN_FRAGMENT_MS );
+            exit( -1 );
+        }
+        if( speech_onset_ms <= 0 || silence_hangover_ms <= 0 )
+        {
+            fprintf( stderr, "Invalid 'Speech Onset' or 'Silence Hangover' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        if( filter_bank == FB_classic && RATE < 16000 )
+        {
+            fprintf( stderr, "The 'classic' filter bank needs 16 kHz audio, use 'mel'!\n" );
+            exit( -1 );
+        }
+
+        if( speech_snr <= silence_snr || silence_snr < 0 )
+        {
+            fprintf( stderr, "Invalid 'Speech SNR' or 'Silence SNR' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        if( trim_guard > TRIM_HOLD_MAX * 10 || trim_snr <= 0 )
+        {
+            fprintf( stderr, "Invalid 'Trim Silence' or 'Trim SNR' in configuration file (the guard is at most %d ms)!\n",
+                     TRIM_HOLD_MAX * 10 );
+            exit( -1 );
+        }
+
+        if( vfr_threshold < 0 )
+        {
+            fprintf( stderr, "Invalid 'Frame Merging' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        if( frame_batch < 0 || batch_latency < 0 )
+        {
+            fprintf( stderr, "Invalid 'Frame Batch' or 'Batch Latency' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        if( early_margin < 0 || early_frames < 0 )
+        {
+            fprintf( stderr, "Invalid 'Early Decision Margin' or 'Early Decision Frames' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        if( keyword_threshold <= 0 || keyword_active < 0 )
+        {
+            fprintf( stderr, "Invalid 'Keyword Threshold' or 'Keyword Active' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        if( wake_threshold <= 0 || wake_time <= 0 )
+        {
+            fprintf( stderr, "Invalid 'Wake Threshold' or 'Wake Time' in configuration file!\n" );
+            exit( -1 );
+        }
+
+        /* convert durations to bytes and 10 ms hops (rounded up) */
+
+        frag_size = MS_TO_BYTES( fragment_ms );
+        speech_onset_hops = ( MS_TO_BYTES( speech_onset_ms ) + OFFSET - 1 ) / OFFSET;
+        silence_hangover_hops = ( MS_TO_BYTES( silence_hangover_ms ) + OFFSET - 1 ) / OFFSET;
+
+        if( capture_policy != SCHED_OTHER &&
+            ( capture_priority < sched_get_priority_min( capture_policy ) ||
+              capture_priority > sched_get_priority_max( capture_policy ) ) )
+        {
+            fprintf( stderr, "Invalid 'Capture Priority' in configuration file!\n" );
+            exit( -1 );
+        }
 
     /***** init mixer device */
 
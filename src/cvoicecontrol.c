@@ -25,6 +25,7 @@
 #include <float.h>
 
 #include <pthread.h>
+#include <signal.h>
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -51,10 +52,18 @@
 
 #include "score.h"
 #include "bb_queue.h"
+#include "dtw.h"
 
 #include "audio.h"
 #include "mixer.h"
 #include "preprocess.h"
+#include "framer.h"
+#include "latency.h"
+#include "realtime.h"
+#include "vad.h"
+#include "trim.h"
+#include "vfr.h"
+#include "spotter.h"
 
 #include "../config.h"
 
@@ -65,16 +74,167 @@ Queue queue2;                                    /* thread-safe queue used to ha
 
 ScoreQueue score_queue;
 
+Spotter spotter;                                 /* keyword spotting, see spotter.h */
+
+/*
+ * state of the time-synchronous recognition of the current utterance
+ *
+ * pos              DTW column of the last feature vector that has been processed
+ * last_frame       (merged) feature vector at 'pos', see vfr.h
+ * abort_requested  set if we are waiting for an 'abort' to arrive through the queues
+ * done             set if recognition of the utterance has been finished successfully
+ * open_end         per sample utterance: open-end score at 'pos' (see earlyDecision())
+ * leader           reference that leads the open-end scores by 'early_margin', -1 if none
+ * leader_since     time (see vfr.h) of the column from which on it has been leading
+ * early            set if the result has been decided before the end of the utterance,
+ *                  its command has not been dispatched yet
+ * margin           margin of the leader at the early decision
+ */
+typedef struct
+{
+    int pos;
+    float last_frame[VFR_VEC_SIZE];
+    int abort_requested;
+    int done;
+    float *open_end;
+    int leader;
+    float leader_since;
+    int early;
+    float margin;
+} Recognizer;
+
+Recognizer recognizer;
+
+/*
+ * speculative end of the current utterance (see speculate())
+ *
+ * pos        DTW column the speculation has been made at, -1 if there is none
+ * tail       feature vectors the utterance would end with (tail_N of them)
+ * queue      the final scores if it does
+ * columns    room for the last two DTW columns of all sample utterances
+ * active     which sample utterances were active
+ * confirmed  number of speculations that have been taken as the result
+ * discarded  number of speculations that have been thrown away at the end
+ *            of an utterance
+ */
+typedef struct
+{
+    int pos;
+    float *tail;
+    int tail_N;
+    ScoreQueue queue;
+    float *columns;
+    char *active;
+    int confirmed;
+    int discarded;
+} Speculation;
+
+Speculation speculation;
+
+/*
+ * wake word cascade (see cvoicecontrol.h)
+ *
+ * context    groups the full model is restricted to (see switchContext())
+ * armed      set while the full model is matched
+ * since      capture time of the wake word or of the last command after it
+ * threshold  score_threshold of the full model
+ * captured   seconds of audio data read so far
+ */
+typedef struct
+{
+    char context[CONTEXT_SIZE];
+    int armed;
+    struct timespec since;
+    float threshold;
+    double captured;
+} Cascade;
+
+Cascade cascade;
+
+/*
+ * state of the front end (framing, preprocessing and batching)
+ *
+ * preprocessor    context the frames are preprocessed with, the same one that
+ *                 the utterances of the speaker model have been preprocessed with
+ * framer          cuts the waveform data into windowed frames
+ * frames          windowed frames of the current chunk, preprocessed together
+ * features        their feature vectors
+ * trimmer         removes the silence before and after the utterance
+ * trimmed         feature vectors the trimmer has kept
+ * vfr             merges runs of similar feature vectors
+ * batch           merged vectors that have not been handed to the recognizer yet,
+ *                 either all vectors of one chunk of audio data or frame_batch
+ *                 vectors, but no later than batch_latency ms
+ * batch_N         number of vectors in batch, at most batch_max (plus the
+ *                 silence the trimmer held back and the pending run)
+ * batch_status    status of the next batch
+ * batch_first     capture time of the audio the first vector in batch belongs to
+ * speculate       set from a 'pause'-type chunk on until the end the utterance
+ *                 would have is handed to the recognizer (see speculateEnd())
+ */
+typedef struct
+{
+    const Preprocessor *preprocessor;
+    Framer framer;
+    float *frames;
+    float *features;
+    Trimmer trimmer;
+    float *trimmed;
+    Vfr vfr;
+    float *batch;
+    int batch_N;
+    int batch_max;
+    enum QStatus batch_status;
+    struct timespec batch_first;
+    int speculate;
+} Frontend;
+
+Frontend frontend;
+
+/*
+ * number of hypotheses the B&B search finishes
+ */
+#define BB_NBEST 6
+
+/*
+ * the B&B search over the rest of an utterance (see runSearch())
+ *
+ * queue           the hypotheses, one per sample utterance
+ * test_utterance  feature vectors of the test utterance from column 'start' on
+ * start, length   DTW column the search started at, length of the test utterance
+ * expansions      DTW columns calculated
+ */
+typedef struct
+{
+    BBQueue queue;
+
+    float **test_utterance;
+    int start;
+    int length;
+
+    int expansions;
+} Search;
+
+Search search;
+
 /*
  * forward declaration:
  * each of these three functions is run in a separate thread
  * these threads are connected via thread safe data queues.
  * Together the three threads form the whole recognizer
+ * (in single-thread mode only 'record' is run, see below)
  */
 void record( void );
 void preprocess( void );
 void recognize( void );
 
+void initRecognizer(  );
+void endRecognizer(  );
+void initFrontend(  );
+void endFrontend(  );
+void switchContext( char *groups );
+void applyContext(  );
+
 /*
  * status of the audio recording thread (plus mutex variables)
  */
@@ -108,6 +268,13 @@ int running = 1;
  */
 int run_once = 0;
 
+/*
+ * if set, recording, preprocessing and recognition are all done by
+ * the recording thread, without any queues in between.
+ * Can be set via command line option (--single-thread)
+ */
+int single_thread = 0;
+
 /* ID of the recognition result. For use in shell scripts */
 int result_id = 0;
 
@@ -311,11 +478,23 @@ void usage( const char *prog )
     printf( "\t               This feature is provided for speech prompts in scripts.\n" );
     printf( "\t-d, --daemon   Run as daemon\n" );
     printf( "\t-v, --verbose  Verbose messages\n" );
+    printf( "\t-s, --single-thread\n" );
+    printf( "\t               Record, preprocess and recognize in a single thread.\n" );
+    printf( "\t               Saves context switches on machines with few cores.\n" );
+    printf( "\t-l, --latency  Report latency breakdown of every utterance.\n" );
+    printf( "\t               Send SIGUSR1 to print latency percentiles.\n" );
     printf( "\t-V, --version  Print version and exit\n" );
     printf( "\t-h, --help     Show this help\n" );
     printf( "\n" );
 }
 
+/* SIGUSR1: print latency percentiles (done by the recording thread) */
+
+void requestLatencyDump( int sig )
+{
+    latencyRequestDump(  );
+}
+
 int main( int argc, char *argv[] )
 {
     /* thread variables */
@@ -324,11 +503,16 @@ int main( int argc, char *argv[] )
     pthread_t recognize_t;
 
     char *model_file;
+    int report_latency = 0;
+    ModelItem *short_item;
+    int short_idx;
 
     struct option long_options[] = {
         { "daemon", no_argument, 0, 'd' },
         { "once", no_argument, 0, 'o' },
         { "verbose", no_argument, 0, 'v' },
+        { "single-thread", no_argument, 0, 's' },
+        { "latency", no_argument, 0, 'l' },
         { "version", no_argument, 0, 'V' },
         { "help", no_argument, 0, 'h' },
         { 0, 0, 0, 0 }
@@ -336,7 +520,7 @@ int main( int argc, char *argv[] )
 
     int ret;
 
-    while( ( ret = getopt_long( argc, argv, "dovVh", long_options, NULL ) ) != -1 )
+    while( ( ret = getopt_long( argc, argv, "dovslVh", long_options, NULL ) ) != -1 )
     {
         switch ( ret )
         {
@@ -349,6 +533,12 @@ int main( int argc, char *argv[] )
             case 'd':
                 g_daemon = 1;
                 break;
+            case 's':
+                single_thread = 1;
+                break;
+            case 'l':
+                report_latency = 1;
+                break;
             case 'V':
                 printf( PACKAGE " version " VERSION "\n" );
                 return 0;
@@ -391,6 +581,42 @@ int main( int argc, char *argv[] )
         exit( -1 );
     }
 
+    /*
+     * remove the silence around the sample utterances and merge runs of similar
+     * feature vectors, the same way as in the incoming utterances
+     */
+    if( trim_guard >= 0 || vfr_threshold > 0 )
+    {
+        int frames = 0, left = 0, i;
+
+        for( i = 0; i < model->total_number_of_sample_utterances; i++ )
+            frames += model->direct[i]->length;
+
+        if( trim_guard >= 0 ) left = trimModel( model, trim_guard, trim_snr );
+        if( vfr_threshold > 0 ) left = compressModel( model, vfr_threshold );
+
+        if( g_verbose )
+            printf( "%d: Trimming and frame merging: %d of %d feature vectors of the speaker model left\n",
+                    ( int )syscall( SYS_gettid ), left, frames );
+    }
+
+    /* the DTW can't align samples that are too short, they have to be deleted in the model editor */
+
+    if( ( short_item = findShortSample( model, &short_idx ) ) != NULL )
+    {
+        fprintf( stderr, "Sample %d of '%s' is too short (fewer than %d feature vectors)!\n",
+                 short_idx, short_item->label, SAMPLE_MIN_LENGTH );
+        exit( -1 );
+    }
+
+    /* the full model starts in the context of the configuration, behind the wake word if there is one */
+
+    cascade.armed = 0;
+    cascade.threshold = score_threshold;
+    cascade.captured = 0;
+    if( start_context[0] != '\0' ) switchContext( start_context );
+    else if( wake_group[0] != '\0' ) applyContext(  );
+
     /*
      * initialize the two thread-safe queues that are
      * used to "connect" the three main threads
@@ -408,25 +634,53 @@ int main( int argc, char *argv[] )
     pthread_mutex_init( &mutex_P_done, NULL );
     setPDone( 0 );
 
-    if( g_verbose ) printf( "%d: Starting threads...\n", syscall( SYS_gettid ) );
+    latencyInit( report_latency );
+    signal( SIGUSR1, requestLatencyDump );
+
+    /* keep the whole process (and the speaker model) resident, if requested */
+    if( lock_memory ) lockMemory( model );
+
+    initRecognizer(  );
+    initFrontend(  );
+
+    if( single_thread )
+    {
+        /* one loop records, preprocesses and recognizes */
+        record(  );
+    }
+    else
+    {
+        if( g_verbose ) printf( "%d: Starting threads...\n", ( int )syscall( SYS_gettid ) );
 
-    /* create the three main threads */
+        /* create the three main threads */
 
-    pthread_create( &record_t, NULL, ( void * )&record, NULL );
-    pthread_create( &preprocess_t, NULL, ( void * )&preprocess, NULL );
-    pthread_create( &recognize_t, NULL, ( void * )&recognize, NULL );
+        pthread_create( &record_t, NULL, ( void * )&record, NULL );
+        pthread_create( &preprocess_t, NULL, ( void * )&preprocess, NULL );
+        pthread_create( &recognize_t, NULL, ( void * )&recognize, NULL );
 
-    waitForAudioStatus( A_off );
-    setAudioStatus( A_prefetching );             /* for now: switch to auto recording after start up */
+        waitForAudioStatus( A_off );
+        setAudioStatus( A_prefetching );         /* for now: switch to auto recording after start up */
 
-    /* join the threads here */
+        /* join the threads here */
 
-    pthread_join( record_t, NULL );
-    pthread_join( preprocess_t, NULL );
-    pthread_join( recognize_t, NULL );
+        pthread_join( record_t, NULL );
+        pthread_join( preprocess_t, NULL );
+        pthread_join( recognize_t, NULL );
+    }
 
     /* cleanup stuff */
 
+    endFrontend(  );
+    endRecognizer(  );
+
+    if( report_latency ) latencyDump( stderr );
+    if( report_latency || g_verbose )
+    {
+        reportDeadlineMisses( stderr );
+        reportVad( stderr );
+        reportCpuUsage( stderr, cascade.captured );
+    }
+
     resetModel( model );
     free( model );
 
@@ -436,903 +690,1337 @@ int main( int argc, char *argv[] )
 }
 
 /********************************************************************************
- * calculate euklidian distance of two feature vectors
+ * score threshold of a sample utterance: the one learned for it (see
+ * model_thresholds.c) where that is below score_threshold
  ********************************************************************************/
 
-inline float euklid_distance( float *a, float *b )
+float sampleThreshold( ModelItemSample *sample )
 {
-    float result = 0;                            /* resulting distance */
-    int i;
-    /*
-     * sum up the squares of the differences of the vector's components
-     * the result is the square root of this value
-     */
-    for( i = 0; i < FEAT_VEC_SIZE; i++ ) result += ( a[i] - b[i] ) * ( a[i] - b[i] );
-    result = sqrt( result );
-    return result;
+    return sample->threshold > 0 && sample->threshold < score_threshold ? sample->threshold : score_threshold;
 }
 
 /********************************************************************************
- * recognizer thread
+ * time-synchronous DTW: advance the matrices of all active sample utterances
+ * by the 'n' merged feature vectors in 'frames' (VFR_VEC_SIZE values each,
+ * see vfr.h), which form the DTW columns
+ * pos .. pos+n-1. 'last_frame' is the feature vector at pos-1.
+ *
+ * Each sample is advanced over the whole batch before the next one is
+ * taken, so its reference data and matrix columns stay in the cache.
+ * Samples that leave the adjustment window or exceed the score threshold
+ * are deactivated. If 'queue' is not NULL, the batch ends the utterance
+ * and the final scores are inserted into it. If 'open_end' is
+ * not NULL, it receives the minimum distance in the last column of each
+ * sample (float_max for the inactive ones).
+ *
+ * returns 0 if all samples have been deactivated, 1 otherwise
  ********************************************************************************/
 
-void recognize( void )
+int dtwAdvance( float *frames, int n, int pos, float *last_frame, ScoreQueue *queue, float *open_end )
 {
-    /*
-     * frame is actual feature vector,
-     * last_frame is feature vector at (pos-1)
-     */
-    float frame[FEAT_VEC_SIZE];
-    float last_frame[FEAT_VEC_SIZE];
-
-    /*
-     * pos is the number of feature vectors
-     * that have been processed
-     */
-    int pos = 0;
-
-    /* initialize the status of the recognition thread to 'Q_invalid' */
+    ModelItemSample *sample;
+    float *frame, *prev_frame;
+    float score, column_min_dist = float_max;
+    int samp, f;
 
-    enum QStatus R_status = Q_invalid;
+    for( samp = 0; samp < model->total_number_of_sample_utterances; samp++ )
+    {
+        sample = model->direct[samp];
 
-    /* loop variables */
+        if( open_end != NULL ) open_end[samp] = float_max;
 
-    int i, j, k;
+        /* skip if sample is inactive */
 
-    /*
-     * set to 1 if we are waiting for an 'abort'
-     * to arrive through the queues
-     */
-    int abort_requested = 0;
+        if( !sample->isActive )
+            continue;
 
-    /*
-     * counter variables for
-     * a) list of references,
-     * b) list of sample utterances
-     */
-    int ref, samp;
+        for( f = 0; f < n; f++ )
+        {
+            frame = frames + f * VFR_VEC_SIZE;
+            prev_frame = f > 0 ? frame - VFR_VEC_SIZE : last_frame;
 
-    /*
-     * temporary pointer to a sample utterance
-     * used during recognition
-     */
-    ModelItemSample *sample;
+            /*
+             * deactivate sample if it is too short to be aligned with the current
+             * adjust_window_width, or if the minimum distance in the current column
+             * exceeds the overall threshold
+             */
+            if( pos + f - adjust_window_width > sample->length )
+                sample->isActive = 0;
+            else if( ( column_min_dist = dtwColumn( sample, pos + f, frame, prev_frame ) ) >
+                     sampleThreshold( sample ) && pos + f > 1 )
+                sample->isActive = 0;
 
-    float act_dist;                              /* (euklid) distance at current DTW position */
-    float column_min_dist;                       /* minimum distance in current DTW column */
-    float tmp_dist;                              /* temp. variable */
+            if( !sample->isActive )
+            {
+                model->number_of_active_sample_utterances--;
+                break;
+            }
+        }
 
-    /* branch&bound related stuff */
+        if( !sample->isActive )
+        {
+            /* all samples deactivated!! */
 
-    /*
-     * indicates whether recognition is done with B&B method
-     */
-    int do_branchNbound = 0;
+            if( model->number_of_active_sample_utterances <= 0 )
+                return 0;
+            continue;
+        }
 
-    /*
-     * position in test utterance where recognizer switched to B&B
-     */
-    int bNb_start_pos = 0;
+        if( open_end != NULL && n > 0 ) open_end[samp] = column_min_dist;
 
-    /*
-     * buffer that holds the preprocessed data of a test utterance
-     * when using B&B method, (plus length of utterance)
-     */
-    float **test_utterance = NULL;
-    int test_utt_length = 0;
+        /*
+         * if the final score is below the score threshold of the sample
+         * enqueue the pair (utterance/score) into the ScoreQueue
+         * (sorted by increasing recognition score)
+         */
+        if( queue != NULL && pos + n - 1 > 1 )
+        {
+            score = dtwScore( sample, pos + n - 1,
+                              n > 0 ? frames[( n - 1 ) * VFR_VEC_SIZE + VFR_TIME] : last_frame[VFR_TIME] );
+            if( score <= sampleThreshold( sample ) )
+                insertInScoreQueue( queue, score, model->direct_map2ref[samp] );
+        }
+    }
 
-    /*
-     * indicate whether recognition run has been finished
-     * successfully
-     */
+    return 1;
+}
 
-    int recognition_done = 0;
+/********************************************************************************
+ * initialize the recognizer
+ ********************************************************************************/
 
-    /*
-     * queue that holds reference utterances sorted by their
-     * recognition score so far.
-     * used in B&B method
-     */
-    BBQueue bb_queue;
-    initBBQueue( &bb_queue );
+void initRecognizer(  )
+{
+    int length = 0, i;
 
     /*
      * some recognizer-specific variables:
      * their meaning is described in server.h
      */
 
-    /* adjust_win_width and score_threshold should be put in a config file type of place */
-    adjust_window_width = 90;
-    sloppy_corner = 4;
-    /* score_threshold = 18; */
-    float_max = FLT_MAX * 0.0001;
+    initDtw(  );
 
     /*
      * initialize score_queue:
-     * this is a queue that holds a sorted (by score) list of recognition hypothesis
-     * from which the final recognition result is derived
+     * this is a queue that holds a sorted (by score) list of the recognition
+     * hypotheses from which the final recognition result is derived
      */
-    initScoreQueue( &score_queue );
+    initScoreQueue( &score_queue, model->total_number_of_sample_utterances, model->number_of_items );
+    initScoreQueue( &speculation.queue, model->total_number_of_sample_utterances, model->number_of_items );
+
+    recognizer.pos = 0;
+    recognizer.abort_requested = 0;
+    recognizer.done = 0;
+    recognizer.open_end = ( float * )malloc( sizeof( float ) * model->total_number_of_sample_utterances );
+    recognizer.leader = -1;
+    recognizer.early = 0;
+
+    if( keyword_spotting ) initSpotter( &spotter, model, sloppy_corner, keyword_threshold, keyword_active );
+
+    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
+        length += model->direct[i]->length;
+
+    speculation.pos = -1;
+    speculation.tail = ( float * )malloc( sizeof( float ) * VFR_VEC_SIZE * ( TRIM_HOLD_MAX + 1 ) );
+    speculation.columns = ( float * )malloc( sizeof( float ) * 2 * length );
+    speculation.active = ( char * )malloc( model->total_number_of_sample_utterances );
+    speculation.confirmed = speculation.discarded = 0;
+}
 
-    if( g_verbose ) printf( "%d: Recognition thread started.\n", syscall( SYS_gettid ) );
+/********************************************************************************
+ * free the memory of the recognizer
+ ********************************************************************************/
 
-    /* main loop of recognition thread */
-    while( running )
-    {
-        /*
-         * report results and reset score queue if recognition
-         * finished successfully.
-         */
-        if( recognition_done )
-        {
-            int id = getResultID( &score_queue );
+void endRecognizer(  )
+{
+    endScoreQueue( &score_queue );
+    free( recognizer.open_end );
 
-            if( g_verbose ) printf( "%d: Recognized ID %d\n", syscall( SYS_gettid ), id );
+    endScoreQueue( &speculation.queue );
+    free( speculation.tail );
+    free( speculation.columns );
+    free( speculation.active );
 
-            recognition_done = 0;
+    if( keyword_spotting ) endSpotter( &spotter );
+}
 
-            if( id >= 0 )                        /* something recognized! */
-            {
-                if( run_once || strcmp( ( getModelItem( model, id ) )->command,
-                                        "cvoicecontrol_off" ) == 0 )
-                {
-                    result_id = id;
+/********************************************************************************
+ * speculative end: the 'n' feature vectors in 'tail' are the ones the
+ * utterance would end with if it ended after the DTW column 'pos' (see
+ * trimEndKnown() in trim.h). The final scores for this end are computed
+ * into the speculation's score queue, on a copy of the DTW state: the
+ * last two columns of all active samples are saved and restored (the
+ * column before them is not needed anymore), like the active flags.
+ *
+ * If the utterance does end like this, the result is known when the end
+ * arrives after the silence hangover (see confirmSpeculation()).
+ ********************************************************************************/
 
-                    /* exit!! */
-                    /*fprintf(stderr, "Exit ID: %d\n", id); */
+void speculate( float *tail, int n )
+{
+    int pos = recognizer.pos;
+    int active_N = model->number_of_active_sample_utterances;
+    ModelItemSample *sample;
+    float *columns;
+    int samp, ok;
 
-                    setAudioStatus( A_exiting );
-                    break;
-                }
-                else
-                {
-                    /* execute command */
-                    /*fprintf(stderr, "%s\n", (getModelItem(model, id))->label); */
-                    system( ( getModelItem( model, id ) )->command );
-                }
-            }
+    speculation.pos = -1;
+    if( pos < 1 || n > TRIM_HOLD_MAX + 1 ) return;
 
-            /* free the space occupied by score_queue */
-            resetScoreQueue( &score_queue );
-            beep(  );
-            setAudioStatus( A_prefetching );
-        }
+    for( samp = 0, columns = speculation.columns; samp < model->total_number_of_sample_utterances; samp++ )
+    {
+        sample = model->direct[samp];
+        speculation.active[samp] = sample->isActive;
+        if( !sample->isActive ) continue;
 
-        /*
-         * time-synchronous calculation of the DTW matrices of all reference utterances
-         * at column 'pos'
-         */
-        if( !do_branchNbound )
-        {
-            float *tmp_data;
+        memcpy( columns, sample->matrix[pos % 3], sizeof( float ) * sample->length );
+        memcpy( columns + sample->length, sample->matrix[( pos - 1 ) % 3], sizeof( float ) * sample->length );
+        columns += 2 * sample->length;
+    }
 
-            /*
-             * If an abort was requested by the last frame that was extracted
-             * from the queue from the preprocessing thread,
-             * we empty the queue until an 'end'- or an 'abort'-type frame
-             * comes through the queue, then the recognizer is reset to
-             * wait for the next utterance ...
-             */
-            if( abort_requested )
-            {
-                /*
-                 * number of remaining frames in queue after
-                 * the preprocessing of the current utterance has finished
-                 */
-                int remaining_frames;
+    resetScoreQueue( &speculation.queue );
+    ok = dtwAdvance( tail, n, pos + 1, recognizer.last_frame, &speculation.queue, NULL );
 
-                enum QStatus tmp_status;         /* temporary variable */
+    for( samp = 0, columns = speculation.columns; samp < model->total_number_of_sample_utterances; samp++ )
+    {
+        sample = model->direct[samp];
+        sample->isActive = speculation.active[samp];
+        if( !sample->isActive ) continue;
 
-                int i;                           /* counter variable */
+        memcpy( sample->matrix[pos % 3], columns, sizeof( float ) * sample->length );
+        memcpy( sample->matrix[( pos - 1 ) % 3], columns + sample->length, sizeof( float ) * sample->length );
+        columns += 2 * sample->length;
+    }
+    model->number_of_active_sample_utterances = active_N;
 
-                /*
-                 * wait until preprocessing has finished,
-                 * then reset P_done to 0 ...
-                 */
-                while( !getPDone(  ) ) ;
-                setPDone( 0 );
+    /* all samples deactivated: the end would be an abort, that is left to the end itself */
 
-                /* ... and empty the queue */
+    if( !ok ) return;
 
-                remaining_frames = numberOfElements( &queue2 );
-                for( i = 0; i < remaining_frames; i++ ) dequeue( &queue2, &tmp_status );
+    memcpy( speculation.tail, tail, sizeof( float ) * VFR_VEC_SIZE * n );
+    speculation.tail_N = n;
+    speculation.pos = pos;
+}
 
-                abort_requested = 0;             /* reset 'abort_requested' to 0 */
+/********************************************************************************
+ * the 'n' feature vectors in 'batch' end the utterance: if they are the
+ * ones of the speculation at the current DTW column, its scores are moved
+ * to the score queue and 1 is returned. Otherwise the speculation is
+ * thrown away and the end has to be calculated, 0 is returned.
+ ********************************************************************************/
 
-                /*  if negative recognition answer is desired, output one here!! */
-                /*  implement any further abort functionality !!!!!? */
+int confirmSpeculation( float *batch, int n )
+{
+    ScoreQueue tmp_queue;
 
-                waitForAudioStatus( A_off );
-                beep(  );
-                setAudioStatus( A_prefetching ); /* switch audio thread back to 'auto recording' */
+    if( speculation.pos < 0 ) return 0;
 
-                continue;
-            }
+    if( speculation.pos != recognizer.pos || speculation.tail_N != n ||
+        memcmp( speculation.tail, batch, sizeof( float ) * VFR_VEC_SIZE * n ) != 0 )
+    {
+        speculation.pos = -1;
+        speculation.discarded++;
+        return 0;
+    }
 
-            /*
-             * get next feature vector from the head of queue2
-             * last frame is moved to last_frame
-             * (the dequeue function blocks the current thread while the queue is empty)
-             */
-            tmp_data = dequeue( &queue2, &R_status );
-            memcpy( last_frame, frame, sizeof( float ) * FEAT_VEC_SIZE );
-            memcpy( frame, tmp_data, sizeof( float ) * FEAT_VEC_SIZE );
-            free( tmp_data );
+    tmp_queue = score_queue;
+    score_queue = speculation.queue;
+    speculation.queue = tmp_queue;
 
-            /*
-             * check whether switching to B&B makes sense
-             * if yes, prepare for and switch to B&B method
-             *
-             * this check is only performed if the first couple of DTW columns,
-             * that need 'special treatment', have already been calculated AND
-             * if preprocessing has already been finished
-             * the latter condition is required as we need to know the actual length
-             * of the currently incoming utterance to be able to use the B&B method!
-             */
-            if( getPDone(  ) && pos >= sloppy_corner + 1 )
-            {
-                /*
-                 * remaining frames to evaluate with B&B  =  frames in the queue + last_frame + (current) frame !
-                 */
-                int remaining_frames = numberOfElements( &queue2 ) + 2;
+    speculation.pos = -1;
+    speculation.confirmed++;
 
-                int i;
-                /* counter variable */
+    if( g_verbose )
+        printf( "%d: Speculative end confirmed (%d confirmed, %d discarded)\n", ( int )syscall( SYS_gettid ),
+                speculation.confirmed, speculation.discarded );
 
-                setPDone( 0 );
-                /* reset P_done to 0 ... */
+    return 1;
+}
 
-                /*
-                 * if at least 30 frames are left to evaluate and abort has not been requested,
-                 * switch to B&B method
-                 */
-                if( remaining_frames >= 30 && !abort_requested )
-                {
-                    test_utt_length = remaining_frames + pos;
-                    /* total length of test utterance */
+/********************************************************************************
+ * early decision: the open-end score of a sample utterance is the best
+ * score of the test utterance so far against any beginning of the sample
+ * (the minimum of the last DTW column), the one of a reference the best
+ * one of its samples. Once a reference leads all other (still active)
+ * references by at least 'early_margin' without interruption for
+ * 'early_frames' frames, it is taken as the result although the user
+ * may still be speaking: returns 1 and inserts its score into the score
+ * queue. 'pos' is the last DTW column, 'time' the time of its test vector.
+ * A margin needs a competitor: while no other reference is active (a
+ * context or wake word stage with a single reference, or all others
+ * dropped), nothing is decided early, any beginning of the sample would
+ * be taken for the whole of it.
+ *
+ * The check is done once per batch, at its last column.
+ ********************************************************************************/
 
-                    /* switch to branch and bound method at DTW column 'pos' */
+int earlyDecision( int pos, float time )
+{
+    int leader = -1, ref, samp;
+    float best = float_max, second = float_max, score;
 
-                    do_branchNbound = 1;
-                    bNb_start_pos = pos;
+    if( pos <= sloppy_corner ) return 0;
 
-                    /* retrieve all remaining frames from queue and put them in an array */
+    /* best and second best reference */
 
-                    test_utterance = ( float ** )malloc( sizeof( float ** ) * remaining_frames );
-                    test_utterance[0] = last_frame;
-                    test_utterance[1] = frame;
-                    for( i = 2; i < remaining_frames; i++ )
-                        test_utterance[i] = dequeue( &queue2, &R_status );
+    for( samp = 0; samp < model->total_number_of_sample_utterances; samp++ )
+    {
+        score = recognizer.open_end[samp];
+        ref = model->direct_map2ref[samp];
 
-                    /*
-                     * setup B&B queue:
-                     * put all sample utterances in the queue sorted by increasing score,
-                     * deactivate all utterances that don't meet the required constraints
-                     * (this can be determined now, as the length of the test utterance is known at this point)
-                     */
-                    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
-                    {
-                        int I = model->direct[i]->length;   /* length of sample utterance */
-                        float tmp_dist = float_max, tmp_dist2;  /* temporary variables */
+        if( score >= float_max ) continue;
 
-                        int j;
+        if( ref == leader )
+        {
+            if( score < best ) best = score;
+        }
+        else if( score < best )
+        {
+            second = best;
+            best = score;
+            leader = ref;
+        }
+        else if( score < second )
+            second = score;
+    }
 
-                        if( !( model->direct[i]->isActive ) ||  /* item still active */
-                            ( ( test_utt_length - 1 ) * 2 + ( sloppy_corner - 1 ) < I - 1 ) ||
-                            /* min slope is 0.5 */
-                            ( ( test_utt_length - sloppy_corner ) / 2 > I - 1 ) ||
-                            /* max slope is 2 */
-                            ( I + adjust_window_width < test_utt_length ) ||
-                            /* adjustment window right side */
-                            ( I - adjust_window_width > test_utt_length ) )
-                            /* adjustment window left side */
-                            continue;
+    if( leader < 0 || second >= float_max || second - best < early_margin )
+    {
+        recognizer.leader = -1;
+        return 0;
+    }
 
-                        /* get minimum distance in actual column */
+    if( leader != recognizer.leader )
+    {
+        recognizer.leader = leader;
+        recognizer.leader_since = time;
+    }
 
-                        for( j = 0; j < I; j++ )
-                        {
-                            tmp_dist2 =
-                                model->direct[i]->matrix[pos % 3][j] / ( ( pos + 1 ) + ( j + 1 ) );
-                            if( tmp_dist2 < tmp_dist ) tmp_dist = tmp_dist2;
-                        }
+    if( time - recognizer.leader_since < early_frames ) return 0;
 
-                        /* insert item into B&B queue */
+    recognizer.margin = second - best;
+    insertInScoreQueue( &score_queue, best, leader );
 
-                        insertIntoBBQueue( &bb_queue, pos + 1, tmp_dist, i );
-                    }
+    return 1;
+}
 
-                    continue;
-                    /* enter next 'while' step in B&B mode */
-                }
-            }
+/********************************************************************************
+ * time-synchronous recognition of the next batch of 'n' feature vectors:
+ * requests an abort if no sample utterance matches anymore and
+ * sets recognizer.done if the batch ends the utterance
+ ********************************************************************************/
 
-            /* react to status of current queue item */
+void recognizeBatch( float *batch, int n, enum QStatus status )
+{
+    /*
+     * time needed for the DTW columns of the batch, must stay below
+     * the duration of the frames they stand for
+     */
+    struct timespec batch_start, batch_end;
+    float duration;
 
-            switch ( R_status )
+    /* react to status of current batch */
+
+    switch ( status )
+    {
+        case Q_invalid:
+            /* this case should not occur! */
+            return;
+        case Q_start:
+            /* start of a new utterance */
+            recognizer.pos = -1;                 /* the batch starts at position 0 */
+            recognizer.abort_requested = 0;
+            recognizer.leader = -1;
+            speculation.pos = -1;
+            resetScoreQueue( &score_queue );
+            /* make sure, the score queue is empty */
+            activateAllSamples( model );
+            /* activate all model items! */
+            break;
+        case Q_data:
+            /* data or end-type batch */
+        case Q_end:
+            if( recognizer.abort_requested ) return;    /* remainder of an aborted utterance */
+
+            /* the end may have been calculated already */
+            if( status == Q_end && confirmSpeculation( batch, n ) )
             {
-                case Q_invalid:
-                    /* this case should not occur! */
-                    break;
-                case Q_start:
-                    /* start of a new utterance */
-                    pos = 0;                     /* start at position 'pos' */
-                    resetScoreQueue( &score_queue );
-                    /* make sure, the score queue is empty */
-                    activateAllSamples( model );
-                    /* activate all model items! */
-                    break;
-                case Q_data:
-                    /* data or end-type frame */
-                case Q_end:
-                    pos++;                       /* advance to next position in DTW matrix */
-                    /* abort_requested = 0; */
-                    break;
-                case Q_abort:
-                    /* start next while loop, abort is handled there */
-                    continue;
-                    break;
-                case Q_exit:
-                    /* exit program */
-                    continue;
-                    break;
+                recognizer.done = 1;
+                return;
             }
+            break;
+        case Q_pause:
+            /* the utterance may end with the vectors of this batch */
+            if( !recognizer.abort_requested ) speculate( batch, n );
+            return;
+        case Q_abort:
+            /* the aborted utterance is complete */
+            recognizer.abort_requested = 0;
+            return;
+        case Q_exit:
+            /* exit program */
+            return;
+    }
 
-            /* loop all sample utterances */
+    /* an empty 'end'-type batch still ends the utterance (its end has been trimmed) */
 
-            for( samp = 0; samp < model->total_number_of_sample_utterances; samp++ )
-            {
-                /* - skip if sample is inactive */
+    if( n == 0 && status != Q_end ) return;
 
-                if( !model->direct[samp]->isActive )
-                    continue;
+    /* advance all sample utterances to the columns pos+1 .. pos+n */
 
-                /*
-                 * ref and sample are pointers to the current reference item and
-                 * sample utterance respectively, just to increase code clarity.
-                 */
-                ref = model->direct_map2ref[samp];
-                sample = model->direct[samp];
+    duration = 0;
+    if( n > 0 )
+    {
+        duration = batch[( n - 1 ) * VFR_VEC_SIZE + VFR_TIME];
+        if( status != Q_start ) duration -= recognizer.last_frame[VFR_TIME];
+    }
 
-                /*
-                 * deactivate sample if it is too short to be aligned with the current
-                 * adjust_window_width, if no more samples are left, request abort!
-                 */
-                if( pos - adjust_window_width > sample->length )
-                {
-                    model->direct[samp]->isActive = 0;
-                    /* deactivate sample */
+    latencyNow( &batch_start );
 
-                    /* all samples deactivated!! request abort! */
+    if( !dtwAdvance( batch, n, recognizer.pos + 1, recognizer.last_frame,
+                     status == Q_end ? &score_queue : NULL, early_margin > 0 && status != Q_end ? recognizer.open_end : NULL ) )
+    {
+        /* all samples deactivated!! request abort! */
 
-                    model->number_of_active_sample_utterances--;
-                    if( model->number_of_active_sample_utterances <= 0 )
-                    {
-                        abort_requested = 1;
-                        setAudioStatus( A_aborting );   /*  what would happen if (audioStatus == A_off) at this point? */
-                        break;
-                        /* break for loop, -> enter next while loop */
-                    }
-                    else
-                        continue;
-                    /* sample deactivated, continue with next sample */
-                }
+        recognizer.abort_requested = 1;
+        setAudioStatus( A_aborting );            /*  what would happen if (audioStatus == A_off) at this point? */
+    }
+    else if( early_margin > 0 && status != Q_end && n > 0 &&
+             earlyDecision( recognizer.pos + n, batch[( n - 1 ) * VFR_VEC_SIZE + VFR_TIME] ) )
+    {
+        /*
+         * the result is clear already: the rest of the utterance is
+         * aborted and the command is dispatched right away
+         */
+        recognizer.early = 1;
+        recognizer.abort_requested = 1;
+        setAudioStatus( A_aborting );
+    }
+
+    latencyNow( &batch_end );
+    if( latencyDiffMs( &batch_start, &batch_end ) > duration * 1000.0 * OFFSET / 2 / RATE )
+        deadlineMissed( D_recognize );
+
+    recognizer.pos += n;
+    if( n > 0 )
+        memcpy( recognizer.last_frame, batch + ( n - 1 ) * VFR_VEC_SIZE, sizeof( float ) * VFR_VEC_SIZE );
+
+    /*
+     * if all sample utterances have been processed at final position
+     * the recognition result can be retrieved from the ScoreQueue
+     */
+    if( status == Q_end && !recognizer.abort_requested )
+        recognizer.done = 1;
+}
+
+/********************************************************************************
+ * restrict the speaker model to the references of the current context: the
+ * wake word group alone while the cascade is not armed, otherwise the groups
+ * of cascade.context. They are used from the next recognition run on.
+ ********************************************************************************/
+
+void applyContext(  )
+{
+    char *groups;
+    int count;
+
+    if( wake_group[0] != '\0' && !cascade.armed )
+    {
+        groups = wake_group;
+        count = setModelContext( model, groups, 0 );
+        score_threshold = wake_threshold;
+    }
+    else
+    {
+        groups = cascade.context;
+        count = setModelContext( model, groups, 1 );
+        score_threshold = cascade.threshold;
+    }
+
+    if( g_verbose )
+        printf( "%d: Context '%s': %d of %d sample utterances\n", ( int )syscall( SYS_gettid ), groups, count,
+                model->total_number_of_sample_utterances );
+}
+
+/********************************************************************************
+ * make the comma separated 'groups' of references the active ones (see model.h)
+ ********************************************************************************/
+
+void switchContext( char *groups )
+{
+    while( *groups == ' ' ) groups++;
+    snprintf( cascade.context, CONTEXT_SIZE, "%s", groups );
+
+    applyContext(  );
+}
 
+/********************************************************************************
+ * wake word cascade: the utterance or the part of the stream captured at
+ * 'stamp' starts. Once the armed full model has gone unused for wake_time
+ * ms, it is left for the wake word group again.
+ ********************************************************************************/
+
+void wakeCheck( const struct timespec *stamp )
+{
+    if( wake_group[0] == '\0' || !cascade.armed || latencyDiffMs( &cascade.since, stamp ) <= wake_time ) return;
+
+    if( g_verbose ) printf( "%d: Wake word timed out\n", ( int )syscall( SYS_gettid ) );
+
+    cascade.armed = 0;
+    applyContext(  );
+}
+
+/********************************************************************************
+ * wake word cascade: reference 'id' has been recognized. A wake word arms
+ * the full model, a command of the full model keeps it armed, both for
+ * the next wake_time ms.
+ ********************************************************************************/
+
+void wakeResult( int id )
+{
+    if( wake_group[0] == '\0' ) return;
+
+    if( !cascade.armed && strcmp( ( getModelItem( model, id ) )->group, wake_group ) != 0 ) return;
+
+    clock_gettime( CLOCK_MONOTONIC, &cascade.since );
+    if( !cascade.armed )
+    {
+        if( g_verbose ) printf( "%d: Wake word, full model armed\n", ( int )syscall( SYS_gettid ) );
+
+        cascade.armed = 1;
+        applyContext(  );
+    }
+}
+
+/********************************************************************************
+ * execute the command of reference 'id', returns 0 if the program is to exit
+ ********************************************************************************/
+
+int runCommand( int id )
+{
+    char *command = ( getModelItem( model, id ) )->command;
+    int length = strlen( CONTEXT_COMMAND );
+
+    if( run_once || strcmp( command, "cvoicecontrol_off" ) == 0 )
+    {
+        result_id = id;
+
+        /* exit!! */
+        /*fprintf(stderr, "Exit ID: %d\n", id); */
+
+        return 0;
+    }
+
+    wakeResult( id );
+
+    /* execute command */
+    /*fprintf(stderr, "%s\n", (getModelItem(model, id))->label); */
+    latencyMark( L_command, NULL );
+    if( strncmp( command, CONTEXT_COMMAND, length ) == 0 && ( command[length] == ' ' || command[length] == '\0' ) )
+        switchContext( command + length );
+    else
+        system( command );
+
+    return 1;
+}
+
+/********************************************************************************
+ * report the result of a finished (or early decided) recognition run and
+ * execute its command, returns 0 if the program is to exit
+ ********************************************************************************/
+
+int reportResult(  )
+{
+    int id = getResultID( &score_queue );
+    int retval = 1;
+
+    latencyMark( L_result, NULL );
+
+    if( g_verbose && recognizer.early )
+        printf( "%d: Recognized ID %d early, at column %d (margin %.3f)\n", ( int )syscall( SYS_gettid ), id,
+                recognizer.pos, recognizer.margin );
+    else if( g_verbose )
+    {
+        ScoreResult nbest[3];
+        int i, n = getNBest( &score_queue, nbest, 3 );
+
+        printf( "%d: Recognized ID %d\n", ( int )syscall( SYS_gettid ), id );
+        for( i = 0; i < n; i++ )
+            printf( "%d:   %d. %s: score %.3f, margin %.3f, %d hypotheses\n", ( int )syscall( SYS_gettid ), i + 1,
+                    ( getModelItem( model, nbest[i].id ) )->label, nbest[i].score, nbest[i].margin, nbest[i].count );
+    }
+
+    if( id >= 0 )                                /* something recognized! */
+        retval = runCommand( id );
+
+    latencyCommit(  );
+
+    /* free the space occupied by score_queue */
+    resetScoreQueue( &score_queue );
+    recognizer.early = 0;
+
+    return retval;
+}
+
+/********************************************************************************
+ * keyword spotting: search the next batch of 'n' feature vectors of the
+ * stream for the references and execute the commands of the ones found
+ * (the times are in seconds since the start of the stream),
+ * returns 0 if the program is to exit
+ ********************************************************************************/
+
+int spotBatch( float *batch, int n, enum QStatus status )
+{
+    Detection detection[SPOT_DETECTIONS_MAX];
+    int i, m = 0;
+
+    switch ( status )
+    {
+        case Q_start:
+            resetSpotter( &spotter );
+            m = spotFrames( &spotter, batch, n, detection );
+            break;
+        case Q_data:
+            m = spotFrames( &spotter, batch, n, detection );
+            break;
+        case Q_exit:
+            /* the end of the stream ends the pending candidate */
+            m = spotFlush( &spotter, detection );
+            break;
+        default:
+            /* the stream is not cut into utterances */
+            break;
+    }
+
+    for( i = 0; i < m; i++ )
+    {
+        if( g_verbose )
+            printf( "%d: Spotted %s (ID %d) at %.2f .. %.2f s, score %.3f, %.0f cells per frame\n",
+                    ( int )syscall( SYS_gettid ), ( getModelItem( model, detection[i].id ) )->label, detection[i].id,
+                    detection[i].start * OFFSET / 2 / RATE, detection[i].end * OFFSET / 2 / RATE,
+                    detection[i].score, spotter.cells / spotter.column );
+
+        if( !runCommand( detection[i].id ) ) return 0;
+    }
+
+    return 1;
+}
+
+/********************************************************************************
+ * expand a B&B hypothesis by the next DTW column of its sample utterance.
+ * returns 0 if it is to be dropped, otherwise 1, item->score is its new score.
+ ********************************************************************************/
+
+int expandHypothesis( BBQueueItem *item )
+{
+    int pos = item->pos;
+    ModelItemSample *sample = model->direct[item->sample_index];
+    float column_min_dist, threshold = sampleThreshold( sample );
+    int bottom, top, j;
+
+    for( j = 0; j < sample->length; j++ )
+        sample->matrix[pos % 3][j] = float_max;
+
+    if( pos < search.length - 1 )
+        /* on right edge, just evaluate sloppy corner items */
+    {
+        bottom = MAX3( 2, pos - adjust_window_width, ( pos - 2 ) / 2 );
+        top =
+            MIN3( sloppy_corner + 1 + ( pos - 1 ) * 2,
+                  sample->length, pos + adjust_window_width );
+    }
+    else
+        /* otherwise follow the general constraints within the DTW matrix */
+    {
+        bottom =
+            MAX3( sample->length - sloppy_corner,
+                  pos - adjust_window_width, ( pos - 2 ) / 2 );
+        top = sample->length;
+    }
+
+    /* calculate relevant entries in the DTW matrix */
+
+    column_min_dist = dtwRows( sample, pos, bottom, top,
+                               search.test_utterance[pos - search.start],
+                               search.test_utterance[pos - search.start - 1], float_max );
+
+    item->pos++;
+    item->score = column_min_dist;
+
+    /* keep the item if the score is still below the threshold */
+
+    return item->score <= threshold;
+}
+
+/********************************************************************************
+ * B&B search: take the first hypothesis of the queue until 'nbest' of them
+ * have been finished, expand it by one DTW column and queue it again.
+ * The finished hypotheses are inserted into the score queue.
+ ********************************************************************************/
+
+void runSearch( int nbest )
+{
+    BBQueue *queue = &search.queue;
+    BBQueueItem *item;
+    int found = 0;
+
+    while( found < nbest && queue->length > 0 )
+    {
+        item = headBBQueue( queue );
+
+        /* at the right corner: the hypothesis is finished */
+
+        if( item->pos == search.length - 1 )
+        {
+            insertInScoreQueue( &score_queue, item->score, model->direct_map2ref[item->sample_index] );
+            releaseBBQueueItem( queue, item );
+            found++;
+            continue;
+        }
+
+        /*
+         * expand the DTW matrix calculation of the hypothesis by one column,
+         * queue it again if the score is still below the threshold
+         */
+        search.expansions++;
+
+        if( expandHypothesis( item ) )
+            insertItemIntoBBQueue( queue, item );
+        else
+            releaseBBQueueItem( queue, item );
+    }
+}
+
+/********************************************************************************
+ * recognizer thread
+ ********************************************************************************/
+
+void recognize( void )
+{
+    /* current batch of feature vectors (batch_N of them) */
+    float *batch;
+    int batch_N;
+
+    /* capture time of the newest audio the batch was computed from */
+    struct timespec batch_stamp;
+
+    /* initialize the status of the recognition thread to 'Q_invalid' */
+
+    enum QStatus R_status = Q_invalid;
+
+    /* loop variable */
+
+    int j;
+
+    /* branch&bound related stuff */
+
+    /*
+     * indicates whether recognition is done with B&B method
+     */
+    int do_branchNbound = 0;
+
+    /*
+     * buffer that holds the preprocessed data of a test utterance
+     * when using B&B method, (plus length of utterance)
+     */
+    float **test_utterance = NULL;
+    float *test_data = NULL;
+    int test_utt_length = 0;
+
+    initBBQueue( &search.queue );
+
+    setupThread( T_recognize );
+
+    if( g_verbose ) printf( "%d: Recognition thread started.\n", syscall( SYS_gettid ) );
+
+    /* main loop of recognition thread */
+    while( running )
+    {
+        /*
+         * report results and reset score queue if recognition
+         * finished successfully.
+         */
+        if( recognizer.done )
+        {
+            recognizer.done = 0;
+
+            if( !reportResult(  ) )
+            {
+                setAudioStatus( A_exiting );
+                break;
+            }
+
+            beep(  );
+            setAudioStatus( A_prefetching );
+        }
+
+        /*
+         * time-synchronous calculation of the DTW matrices of all reference utterances
+         * at the columns of the next batch of feature vectors
+         */
+        if( !do_branchNbound )
+        {
+            /*
+             * If an abort was requested by the last batch that was extracted
+             * from the queue from the preprocessing thread,
+             * we empty the queue until an 'end'- or an 'abort'-type batch
+             * comes through the queue, then the recognizer is reset to
+             * wait for the next utterance ...
+             */
+            if( recognizer.abort_requested )
+            {
                 /*
-                 * after all items in a column are calculated, this variable contains the minimum
-                 * distance value in the current column
+                 * number of remaining batches in queue after
+                 * the preprocessing of the current utterance has finished
                  */
-                column_min_dist = float_max;
+                int remaining_batches;
 
-                /* fill actual DTW matrix column */
+                enum QStatus tmp_status;         /* temporary variable */
 
-                if( pos == 0 )
-                    /* at pos == 0, we initialize the first matrix column */
-                {
-                    /* initialize current DTW matrix column, i.e. set all values to 'infinity' */
+                int i;                           /* counter variable */
 
-                    for( k = 0; k < sample->length; k++ )
-                        sample->matrix[0][k] = float_max;
+                /*
+                 * wait until preprocessing has finished,
+                 * then reset P_done to 0 ...
+                 */
+                while( !getPDone(  ) ) ;
+                setPDone( 0 );
 
-                    /* ccalculate the first <sloppy_corner> items in the current column */
+                /* ... and empty the queue */
 
-                    sample->matrix[0][0] = 2 * euklid_distance( sample->data[0], frame );
-                    column_min_dist = sample->matrix[0][0] / ( ( 0 + 1 ) + ( 0 + 1 ) );
+                remaining_batches = numberOfElements( &queue2 );
+                for( i = 0; i < remaining_batches; i++ ) free( dequeue( &queue2, &tmp_status ) );
 
-                    for( i = 1; i < sloppy_corner; i++ )
-                    {
-                        sample->matrix[0][i] =
-                            sample->matrix[0][i - 1] + euklid_distance( sample->data[i], frame );
+                recognizer.abort_requested = 0;  /* reset 'abort_requested' to 0 */
 
-                        tmp_dist = sample->matrix[0][i] / ( ( 0 + 1 ) + ( i + 1 ) );
-                        if( tmp_dist < column_min_dist )
-                            column_min_dist = tmp_dist;
-                    }
-                }
-                else if( pos == 1 )
-                {
-                    /*
-                     * at pos == 1, we use a special (shorter) warping function
-                     * as the history (of one matrix column) does not allow
-                     * for the application of the full warping function yet
-                     */
+                /*  if negative recognition answer is desired, output one here!! */
+                /*  implement any further abort functionality !!!!!? */
 
-                    /* initialize current DTW matrix column, i.e. set all values to 'infinity' */
+                waitForAudioStatus( A_off );
+                beep(  );
+                setAudioStatus( A_prefetching ); /* switch audio thread back to 'auto recording' */
 
-                    for( k = 0; k < sample->length; k++ )
-                        sample->matrix[1][k] = float_max;
+                continue;
+            }
 
-                    /* calculate the first <sloppy_corner+1> elements */
+            /*
+             * get next batch of feature vectors from the head of queue2
+             * (the dequeue function blocks the current thread while the queue is empty)
+             */
+            batch = dequeueStamped( &queue2, &R_status, &batch_stamp, &batch_N );
+            batch_N /= VFR_VEC_SIZE;
 
-                    sample->matrix[1][0] =
-                        sample->matrix[0][0] + euklid_distance( sample->data[0], frame );
-                    column_min_dist = sample->matrix[1][0] / ( ( 1 + 1 ) + ( 0 + 1 ) );
+            latencyFrameAge( &batch_stamp );
 
-                    sample->matrix[1][1] =
-                        MIN3( sample->matrix[0][1] + act_dist,
-                              sample->matrix[1][0] + act_dist,
-                              sample->matrix[0][0] + 2 * act_dist );
+            /* the armed full model may have to be left at the start of an utterance */
+            if( R_status == Q_start || keyword_spotting ) wakeCheck( &batch_stamp );
 
-                    tmp_dist = sample->matrix[1][1] / ( ( 1 + 1 ) + ( 1 + 1 ) );
-                    if( tmp_dist < column_min_dist )
-                        column_min_dist = tmp_dist;
+            /* keyword spotting: the stream is never cut into utterances */
 
-                    for( i = 2; i < sloppy_corner + 1; i++ )
-                    {
-                        act_dist = euklid_distance( sample->data[i], frame );
+            if( keyword_spotting )
+            {
+                if( !spotBatch( batch, batch_N, R_status ) )
+                {
+                    free( batch );
+                    setAudioStatus( A_exiting );
+                    break;
+                }
+                free( batch );
+                if( R_status == Q_exit ) break;
+                continue;
+            }
 
-                        sample->matrix[1][i] =
-                            MIN3( sample->matrix[0][i] + act_dist,
-                                  sample->matrix[0][i - 1] + 2 * act_dist,
-                                  sample->matrix[0][i - 2] +
-                                  2 * euklid_distance( sample->data[i - 1], frame ) + act_dist );
+            /*
+             * check whether switching to B&B makes sense
+             * if yes, prepare for and switch to B&B method
+             *
+             * this check is only performed if the first couple of DTW columns,
+             * that need 'special treatment', have already been calculated AND
+             * if preprocessing has already been finished
+             * the latter condition is required as we need to know the actual length
+             * of the currently incoming utterance to be able to use the B&B method!
+             * (a 'start'-type batch belongs to a new utterance, 'pos' is not valid for it)
+             */
+            if( ( R_status == Q_data || R_status == Q_end ) &&
+                getPDone(  ) && recognizer.pos >= sloppy_corner + 1 )
+            {
+                int pos = recognizer.pos;
 
-                        tmp_dist = sample->matrix[1][i] / ( ( 1 + 1 ) + ( i + 1 ) );
-                        if( tmp_dist < column_min_dist )
-                            column_min_dist = tmp_dist;
-                    }
-                }
-                else if( pos > 1 )
-                {
-                    /*
-                     * beyond pos == 1, the warping function lies inside the matrix
-                     * and can be calculated completely.
-                     */
+                /*
+                 * remaining frames to evaluate with B&B  =
+                 *   last_frame + (current) batch + batches in the queue !
+                 */
+                int remaining_frames = 1 + batch_N + totalSize( &queue2 ) / VFR_VEC_SIZE;
 
-                    /* initialize current DTW matrix column, i.e. set all values to 'infinity' */
+                int i;
+                /* counter variable */
 
-                    for( k = 0; k < sample->length; k++ )
-                        sample->matrix[pos % 3][k] = float_max;
+                setPDone( 0 );
+                /* reset P_done to 0 ... */
 
-                    /* take care of sloppy start */
+                /*
+                 * if at least 30 frames are left to evaluate and abort has not been requested,
+                 * switch to B&B method
+                 */
+                if( remaining_frames >= 30 && !recognizer.abort_requested )
+                {
+                    float *tmp_data;
+                    int size;
 
-                    if( pos < sloppy_corner )
-                        /* element in first row of DTW matrix */
-                    {
-                        sample->matrix[pos % 3][0] =
-                            sample->matrix[( pos - 1 ) % 3][0] +
-                            euklid_distance( sample->data[0], frame );
-                        column_min_dist = sample->matrix[pos % 3][0] / ( ( pos + 1 ) + ( 0 + 1 ) );
-                    }
-                    if( pos < sloppy_corner + 1 )
-                        /* element in second row of DTW matrix */
-                    {
-                        act_dist = euklid_distance( sample->data[1], frame );
+                    test_utt_length = remaining_frames + pos;
+                    /* total length of test utterance */
 
-                        /* use a simpler, smaller warping function that fits into the DTW matrix */
+                    /* switch to branch and bound method at DTW column 'pos' */
 
-                        sample->matrix[pos % 3][1] =
-                            MIN3( sample->matrix[pos % 3][0] + act_dist,
-                                  sample->matrix[( pos - 1 ) % 3][0] +
-                                  2 * act_dist,
-                                  sample->matrix[( pos - 2 ) % 3][0] +
-                                  2 * euklid_distance( sample->data[1], last_frame ) + act_dist );
+                    do_branchNbound = 1;
+                    latencyMark( L_bb_switch, NULL );
 
-                        tmp_dist = sample->matrix[pos % 3][1] / ( ( pos + 1 ) + ( 1 + 1 ) );
-                        if( tmp_dist < column_min_dist )
-                            column_min_dist = tmp_dist;
-                    }
+                    /* retrieve all remaining frames from queue and put them in an array */
 
-                    /*
-                     * loop rows in current DTW column within
-                     * - range of adjust_window,
-                     * - range of warping function
-                     * - sample length
-                     */
+                    test_data = ( float * )malloc( sizeof( float ) * VFR_VEC_SIZE * remaining_frames );
+                    memcpy( test_data, recognizer.last_frame, sizeof( float ) * VFR_VEC_SIZE );
+                    memcpy( test_data + VFR_VEC_SIZE, batch, sizeof( float ) * VFR_VEC_SIZE * batch_N );
+                    free( batch );
 
-                    for( j =
-                         MAX3( 2, pos - adjust_window_width, ( pos - 2 ) / 2 );
-                         j < MIN3( sloppy_corner + 1 + ( pos - 1 ) * 2,
-                                   sample->length, pos + adjust_window_width ); j++ )
+                    for( i = 1 + batch_N; i < remaining_frames; )
                     {
-                        act_dist = euklid_distance( sample->data[j], frame );
-
-                        /*
-                         * apply warping function to calculate current DTW matrix element
-                         * (see server.h for description of warping function)
-                         */
-
-                        if( sample->matrix[( pos - 1 ) % 3][j - 1] < float_max
-                            || sample->matrix[( pos - 1 ) % 3][j - 2] <
-                            float_max || sample->matrix[( pos - 2 ) % 3][j - 1] < float_max )
+                        tmp_data = dequeueStamped( &queue2, &R_status, NULL, &size );
+                        if( R_status == Q_pause )
                         {
-                            sample->matrix[pos % 3][j] =
-                                MIN3( sample->matrix[( pos - 1 ) % 3][j - 1] +
-                                      2 * act_dist,
-                                      sample->matrix[( pos - 1 ) % 3][j - 2] +
-                                      2 * euklid_distance( sample->data[j - 1],
-                                                           frame ) + act_dist,
-                                      sample->matrix[( pos - 2 ) % 3][j - 1] +
-                                      2 * euklid_distance( sample->data[j],
-                                                           last_frame ) + act_dist );
-
-                            tmp_dist = sample->matrix[pos % 3][j] / ( ( pos + 1 ) + ( j + 1 ) );
-                            if( tmp_dist < column_min_dist )
-                                column_min_dist = tmp_dist;
+                            /* a speculative end (see speculate()) is not part of the utterance */
+
+                            remaining_frames -= size / VFR_VEC_SIZE;
+                            test_utt_length -= size / VFR_VEC_SIZE;
                         }
                         else
-                            sample->matrix[pos % 3][j] = float_max;
+                        {
+                            memcpy( test_data + i * VFR_VEC_SIZE, tmp_data, sizeof( float ) * size );
+                            i += size / VFR_VEC_SIZE;
+                        }
+                        free( tmp_data );
                     }
 
+                    test_utterance = ( float ** )malloc( sizeof( float * ) * remaining_frames );
+                    for( i = 0; i < remaining_frames; i++ )
+                        test_utterance[i] = test_data + i * VFR_VEC_SIZE;
+
                     /*
-                     * if the minimum distance in the current row exceeds the
-                     * overall threshold, deactivate this sample utterance!
+                     * setup B&B queue:
+                     * put all sample utterances in the queue sorted by increasing score,
+                     * deactivate all utterances that don't meet the required constraints
+                     * (this can be determined now, as the length of the test utterance is known at this point)
                      */
+                    search.test_utterance = test_utterance;
+                    search.start = pos;
+                    search.length = test_utt_length;
+                    search.expansions = 0;
 
-                    if( column_min_dist > score_threshold )
+                    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
                     {
-                        model->direct[samp]->isActive = 0;
-                        /* deactivate sample */
+                        int I = model->direct[i]->length;   /* length of sample utterance */
+                        float tmp_dist = float_max, tmp_dist2;  /* temporary variables */
 
-                        /* all samples deactivated!! request abort! */
+                        int j;
 
-                        model->number_of_active_sample_utterances--;
-                        if( model->number_of_active_sample_utterances <= 0 )
-                        {
-                            abort_requested = 1;
-                            setAudioStatus( A_aborting );   /*  what would happen if (audioStatus == A_off) at this point? */
-                            break;
-                            /* break for loop, -> enter next while loop */
-                        }
-                        else
+                        if( !( model->direct[i]->isActive ) ||  /* item still active */
+                            ( ( test_utt_length - 1 ) * 2 + ( sloppy_corner - 1 ) < I - 1 ) ||
+                            /* min slope is 0.5 */
+                            ( ( test_utt_length - sloppy_corner ) / 2 > I - 1 ) ||
+                            /* max slope is 2 */
+                            ( I + adjust_window_width < test_utt_length ) ||
+                            /* adjustment window right side */
+                            ( I - adjust_window_width > test_utt_length ) )
+                            /* adjustment window left side */
                             continue;
-                    }
 
-                    if( R_status == Q_end )
-                    {
-                        /* calculate score from upper right corner of DTW matrix */
+                        /* get minimum distance in actual column */
 
-                        int s;
-                        float tmp_score =
-                            sample->matrix[pos % 3][sample->length - 1] / ( pos + sample->length );
-                        for( s = 1; s < sloppy_corner; s++ )
+                        for( j = 0; j < I; j++ )
                         {
-                            tmp_dist =
-                                sample->matrix[pos % 3][sample->length - 1 -
-                                                        s] / ( pos + sample->length - s );
-                            if( tmp_dist < tmp_score )
-                                tmp_score = tmp_dist;
+                            tmp_dist2 =
+                                model->direct[i]->matrix[pos % 3][j] /
+                                ( recognizer.last_frame[VFR_TIME] + model->direct[i]->time[j] );
+                            if( tmp_dist2 < tmp_dist ) tmp_dist = tmp_dist2;
                         }
 
-                        /*
-                         * if the final score is below the score_threshold
-                         * enqueue the pair (utterance/score) into the ScoreQueue
-                         *  (sorted by increasing recognition score)
-                         */
-                        if( tmp_score <= score_threshold )
-                            insertInScoreQueue( &score_queue, tmp_score, ref );
+                        /* insert item into B&B queue */
+
+                        insertIntoBBQueue( &search.queue, pos + 1, tmp_dist, i );
                     }
-                    /*  if (R_status == Q_end)  */
-                }
-                /*  else if (pos > 1) */
 
+                    continue;
+                    /* enter next 'while' step in B&B mode */
+                }
             }
-            /*  for (samp ...) */
 
-            /*
-             * if all sample utterances have been processed at final position
-             * retrieve recognition result from ScoreQueue
-             */
-            if( R_status == Q_end && !abort_requested )
-            {
-                /* ready for the next recording session */
+            recognizeBatch( batch, batch_N, R_status );
+            free( batch );
 
-                waitForAudioStatus( A_off );
-                //fprintf(stderr, ".");
+            /* the 'exit'-type batch is the last one, 'running' may not be reset yet */
+            if( R_status == Q_exit ) break;
 
-                recognition_done = 1;
+            /* dispatch an early decision now, the rest of the utterance is aborted */
+
+            if( recognizer.early && !reportResult(  ) )
+            {
+                setAudioStatus( A_exiting );
+                break;
             }
+
+            /* ready for the next recording session */
+
+            if( recognizer.done )
+                waitForAudioStatus( A_off );
         }
         else                                     /* B&B mode! */
         {
-            BBQueueItem *item = 0;
-
-            int nbest = 6;                       /* find the 'nbest' best hypotheses using B&B the method */
-            int nbest_found = 0;
-
-            /* do B&B until 'nbest' hypotheses have been found or B&B queue is empty */
+            /* find the BB_NBEST best hypotheses using the B&B method */
 
-            while( nbest_found < nbest && bb_queue.length > 0 )
-            {
-                /* remove first element (having minimum score) from list */
+            runSearch( BB_NBEST );
 
-                item = headBBQueue( &bb_queue );
+            /* ready for next recording session */
+            waitForAudioStatus( A_off );
+            //fprintf(stderr, ",");
 
-                /*
-                 * if (at right corner) -> best item found
-                 * (increase N-best counter, if ==0, stop)
-                 */
-                if( item->pos == test_utt_length - 1 )
-                {
-                    /* insert results of current hypothesis into the score queue */
+            /* B&B search done, report results */
 
-                    insertInScoreQueue( &score_queue, item->score,
-                                        model->direct_map2ref[item->sample_index] );
+            resetBBQueue( &search.queue );
 
-                    nbest_found++;
-                    free( item );
-                }
-                else
-                {
-                    /*
-                     * else expand the DTW matrix calculation of
-                     * the current sample utterance by one column ...
-                     */
-                    int pos = item->pos;
-                    ModelItemSample *sample = model->direct[item->sample_index];
-                    float column_min_dist = float_max;
-                    float tmp_dist;
-                    int bottom, top;
+            if( g_verbose )
+                printf( "%d: B&B: %d expansions\n", ( int )syscall( SYS_gettid ), search.expansions );
 
-                    for( j = 0; j < sample->length; j++ )
-                        sample->matrix[pos % 3][j] = float_max;
+            /* reset B&B related variables */
+            free( test_data );
+            free( test_utterance );
+            test_data = NULL;
+            test_utterance = NULL;
+            do_branchNbound = 0;
 
-                    if( pos < test_utt_length - 1 )
-                        /* on right edge, just evaluate sloppy corner items */
-                    {
-                        bottom = MAX3( 2, pos - adjust_window_width, ( pos - 2 ) / 2 );
-                        top =
-                            MIN3( sloppy_corner + 1 + ( pos - 1 ) * 2,
-                                  sample->length, pos + adjust_window_width );
-                    }
-                    else
-                        /* otherwise follow the general constraints within the DTW matrix */
-                    {
-                        bottom =
-                            MAX3( sample->length - sloppy_corner,
-                                  pos - adjust_window_width, ( pos - 2 ) / 2 );
-                        top = sample->length;
-                    }
+            recognizer.done = 1;
+        }
+    }
 
-                    /* calculate relevant entries in the DTW matrix */
+    endBBQueue( &search.queue );
+}
 
-                    for( j = bottom; j < top; j++ )
-                    {
-                        act_dist =
-                            euklid_distance( sample->data[j], test_utterance[pos - bNb_start_pos] );
+/********************************************************************************
+ * initialize the front end of the recognizer
+ ********************************************************************************/
 
-                        /*
-                         * apply warping function to calculate current DTW matrix element
-                         * (see server.h for a detailed description of the warping function)
-                         */
+void initFrontend(  )
+{
+    if( ( frontend.preprocessor = defaultPreprocessor(  ) ) == NULL )
+    {
+        fprintf( stderr, "Failed to initialize preprocessing!\n" );
+        exit( -1 );
+    }
 
-                        if( sample->matrix[( pos - 1 ) % 3][j - 1] < float_max
-                            || sample->matrix[( pos - 1 ) % 3][j - 2] <
-                            float_max || sample->matrix[( pos - 2 ) % 3][j - 1] < float_max )
-                        {
-                            sample->matrix[pos % 3][j] =
-                                MIN3( sample->matrix[( pos - 1 ) % 3][j - 1] +
-                                      2 * act_dist,
-                                      sample->matrix[( pos - 1 ) % 3][j - 2] +
-                                      2 * euklid_distance( sample->data[j - 1],
-                                                           test_utterance[pos -
-                                                                          bNb_start_pos] )
-                                      + act_dist,
-                                      sample->matrix[( pos - 2 ) % 3][j - 1] +
-                                      2 * euklid_distance( sample->data[j],
-                                                           test_utterance[pos -
-                                                                          bNb_start_pos
-                                                                          - 1] ) + act_dist );
-
-                            tmp_dist = sample->matrix[pos % 3][j] / ( ( pos + 1 ) + ( j + 1 ) );
-                            if( tmp_dist < column_min_dist )
-                                column_min_dist = tmp_dist;
-                        }
-                        else
-                            sample->matrix[pos % 3][j] = float_max;
-                    }
+    /* all frames are taken from each chunk before the next one arrives */
+    initFramer( &frontend.framer, frag_size, frontend.preprocessor->hamming_window );
+    frontend.frames = ( float * )malloc( sizeof( float ) * FFT_SIZE * ( frag_size / OFFSET + 2 ) );
+
+    frontend.features = ( float * )malloc( sizeof( float ) * FEAT_VEC_SIZE * ( frag_size / OFFSET + 2 ) );
+    initTrimmer( &frontend.trimmer, keyword_spotting ? -1 : trim_guard, trim_snr );  /* a stream is not trimmed */
+    frontend.trimmed = ( float * )malloc( sizeof( float ) * FEAT_VEC_SIZE * ( TRIM_HOLD_MAX + 1 ) );
+    initVfr( &frontend.vfr, vfr_threshold );
+
+    frontend.batch_max = frame_batch > 0 ? frame_batch : frag_size / OFFSET + 2;
+    frontend.batch = ( float * )malloc( sizeof( float ) * VFR_VEC_SIZE *
+                                        ( frontend.batch_max + TRIM_HOLD_MAX + 1 ) );
+    frontend.batch_N = 0;
+    frontend.batch_status = Q_data;
+    frontend.speculate = 0;
+}
 
-                    /* reinsert the item into the BBQueue if the score is still below the threshold */
+/********************************************************************************
+ * free any memory allocated by the front end
+ ********************************************************************************/
 
-                    if( column_min_dist <= score_threshold )
-                    {
-                        item->pos++;
-                        item->score = column_min_dist;
+void endFrontend(  )
+{
+    endFramer( &frontend.framer );
+    free( frontend.frames );
+    free( frontend.features );
+    free( frontend.trimmed );
+    free( frontend.batch );
+}
 
-                        insertItemIntoBBQueue( &bb_queue, item );
-                    }
-                }
-            }
+/********************************************************************************
+ * hand the collected feature vectors to the recognizer as one batch
+ ********************************************************************************/
 
-            /* ready for next recording session */
-            waitForAudioStatus( A_off );
-            //fprintf(stderr, ",");
+void emitBatch( enum QStatus status, const struct timespec *stamp )
+{
+    if( single_thread )
+    {
+        latencyFrameAge( stamp );
+        if( status == Q_start || keyword_spotting ) wakeCheck( stamp );
 
-            /* B&B search done, report results */
+        if( keyword_spotting )
+        {
+            if( !spotBatch( frontend.batch, frontend.batch_N, status ) ) setAudioStatus( A_exiting );
+        }
+        else
+        {
+            recognizeBatch( frontend.batch, frontend.batch_N, status );
 
-            resetBBQueue( &bb_queue );
-            /* reset B&B related variables */
-            for( i = 2; i < test_utt_length - bNb_start_pos; i++ )
-                free( test_utterance[i] );
-            free( test_utterance );
-            test_utterance = NULL;
-            do_branchNbound = 0;
+            /* dispatch an early decision now, the rest of the utterance is aborted */
 
-            recognition_done = 1;
+            if( recognizer.early && !reportResult(  ) ) setAudioStatus( A_exiting );
         }
     }
+    else
+        enqueueStamped( &queue2, frontend.batch, frontend.batch_N * VFR_VEC_SIZE, status, stamp );
+
+    frontend.batch_N = 0;
 }
 
 /********************************************************************************
- * preprocessing thread
+ * merge the 'n' feature vectors in 'features' into the next slots of the batch
  ********************************************************************************/
 
-void preprocess( void )
+void batchVectors( const float *features, int n )
 {
-    /* data container used for fft calculation */
-    float frame[FFT_SIZE];
+    int k;
 
-    /* holds current buffer of waveform data plus remainders of last buffer */
-    unsigned char buffer[FRAG_SIZE + OFFSET];
+    for( k = 0; k < n; k++ )
+        frontend.batch_N += vfrPush( &frontend.vfr, features + k * FEAT_VEC_SIZE,
+                                     frontend.batch + frontend.batch_N * VFR_VEC_SIZE );
+}
 
-    /* amount of valid chars in buffer, 0 .. frag_size+offset */
-    int buffer_counter = 0;
+/********************************************************************************
+ * speech has stopped: once the trimmer knows the vectors the utterance
+ * would end with if no more speech came, they are handed to the recognizer
+ * in a 'pause'-type batch (after the pending vectors), which calculates
+ * the result for this end during the silence hangover (see speculate()).
+ * Without trimming, the end is only known at the end of the hangover.
+ ********************************************************************************/
 
-    /* number of whole frames that can be extracted from current waveform buffer */
-    int frames_N;
+void speculateEnd( const struct timespec *stamp )
+{
+    Vfr vfr = frontend.vfr;
+    int k, n;
 
-    /* counter variables */
-    int frameI, i;
+    if( !frontend.speculate || frontend.batch_status != Q_data || !trimEndKnown( &frontend.trimmer ) )
+        return;
 
-    /* remainder  */
-    int remainder;
+    if( frontend.batch_N > 0 ) emitBatch( Q_data, stamp );
 
-    /* status of current queue item */
-    enum QStatus P_status;
+    /* the end, as trimFlush() and vfrFlush() would have it, on a copy of the merging */
 
-    /* init melscale buffer ... */
-    float feat_vector[FEAT_VEC_SIZE];
+    n = trimPeek( &frontend.trimmer, frontend.trimmed );
+    for( k = 0; k < n; k++ )
+        frontend.batch_N += vfrPush( &vfr, frontend.trimmed + k * FEAT_VEC_SIZE,
+                                     frontend.batch + frontend.batch_N * VFR_VEC_SIZE );
+    frontend.batch_N += vfrFlush( &vfr, frontend.batch + frontend.batch_N * VFR_VEC_SIZE );
 
-    /* initialize preprocessing */
-    initPreprocess(  );
+    emitBatch( Q_pause, stamp );
+    frontend.speculate = 0;
+}
 
-    if( g_verbose ) printf( "%d: Preprocessing thread started.\n", syscall( SYS_gettid ) );
+/********************************************************************************
+ * preprocess the next chunk of 'size' bytes of audio data,
+ * 'stamp' is its capture time
+ ********************************************************************************/
 
-    /* main loop of the preprocessing thread */
-    while( running )
+void preprocessChunk( unsigned char *data, int size, enum QStatus status,
+                      const struct timespec *stamp )
+{
+    /* number of whole frames that can be extracted from current waveform buffer */
+    int frames_N;
+
+    /* counter variables, number of frames preprocessed in one go */
+    int frameI, k, n;
+
+    /* time needed to compute the frames (excluding the hand-over of batches) */
+    struct timespec frame_start, frame_end;
+    double frames_ms = 0;
+
+    /* react to status of current chunk */
+    switch ( status )
     {
-        /*
-         * get head data and status from queue1
-         * (the dequeue function blocks the preprocessing thread if the queue is empty!)
-         */
-        char *tmp_data = ( char * )dequeue( &queue1, &P_status );
-        memcpy( buffer + buffer_counter, tmp_data, FRAG_SIZE );
-        free( tmp_data );
+        case Q_invalid:
+            /* this case should not occur! */
+            break;
 
-        /* react to status of current queue item */
-        switch ( P_status )
-        {
-            case Q_invalid:
-                /* this case should not occur! */
-                break;
+        case Q_start:
+            /* start of a new utterance */
+            resetFramer( &frontend.framer );
+            resetTrimmer( &frontend.trimmer );
+            resetVfr( &frontend.vfr );
+            /* drop the remainder of the last utterance */
+            frontend.batch_N = 0;
+            frontend.batch_status = Q_start;
+            frontend.speculate = 0;
+            /* the first batch starts the utterance */
+            while( getPDone(  ) != 0 ) setPDone( 0 );
+            /* make sure P_done is set to 0 */
+            break;
 
-            case Q_start:
-                /* start of a new utterance */
-                buffer_counter = 0;
-                /* set buffer_counter to the beginning of the buffer */
-                while( getPDone(  ) != 0 ) setPDone( 0 );
-                /* make sure P_done is set to 0 */
-                break;
+        case Q_pause:
+            /* speech has stopped, the utterance may end soon */
+            frontend.speculate = 1;
+        case Q_data:
+            /* nothing special to do at this point, just process data below */
+        case Q_end:
+            break;
 
-            case Q_data:
-                /* nothing special to do at this point, just process data below */
-            case Q_end:
-                break;
+        case Q_abort:
+            /* don't process this chunk */
+            /* pass an (empty) 'abort'-type batch to signal 'aborting'! */
+            frontend.batch_N = 0;
+            emitBatch( Q_abort, stamp );
+            setPDone( 1 );
+            return;
+
+        case Q_exit:
+            frontend.batch_N = 0;
+            emitBatch( Q_exit, stamp );
+            return;
+    }
 
-            case Q_abort:
-                /* don't process this frame */
-                /* insert an 'abort' marked frame into the queue to signal 'aborting'! */
-                enqueue( &queue2, feat_vector, FEAT_VEC_SIZE, Q_abort );
-                setPDone( 1 );
-                continue;                        /* skip the current step of the while loop */
-                break;
+    /* append the received data to the waveform kept by the framer */
+    latencyNow( &frame_start );
+    framerPush( &frontend.framer, data, size );
+    latencyNow( &frame_end );
+    frames_ms += latencyDiffMs( &frame_start, &frame_end );
 
-            case Q_exit:
-                enqueue( &queue2, feat_vector, FEAT_VEC_SIZE, Q_exit );
-                continue;
-                break;
-        }
+    /*
+     * number of frames that can be extracted from the current amount
+     * of available audio data
+     */
+    frames_N = framerFrames( &frontend.framer );
 
-        /* make the buffer_counter point behind the currently received data */
-        buffer_counter += FRAG_SIZE;
+    /* extract these frames: */
 
-        /*
-         * number of frames that can be extracted from the current amount
-         * of available audio data
-         */
-        frames_N = ( buffer_counter - FFT_SIZE_CHAR ) / OFFSET + 1;
+    for( frameI = 0; frameI < frames_N; frameI += n )
+    {
+        /* as many frames as fit into the batch ... */
+        n = MIN2( frames_N - frameI, frontend.batch_max - frontend.batch_N );
 
-        /* extract these frames: */
+        latencyNow( &frame_start );
 
-        for( frameI = 0; frameI < frames_N; frameI++ )
-        {
-            /* prepare a hamming windowed frame from the audio data ... */
+        /* ... are prepared as hamming windowed frames from the audio data ... */
+        for( k = 0; k < n; k++ )
+            framerFrame( &frontend.framer, frontend.frames + k * FFT_SIZE );
 
-            for( i = 0; i < FFT_SIZE; i++ )
-                frame[i] =
-                    ( ( float )
-                      ( ( signed short )( buffer[frameI * OFFSET + 2 * i] |
-                                          ( buffer[frameI * OFFSET + 2 * i + 1]
-                                            << 8 ) ) ) ) * hamming_window[i];
+        /* ... preprocessed together ... */
+        preprocessFrames( frontend.preprocessor, n, frontend.frames, frontend.features );
 
-            preprocessFrame( frame, feat_vector );  /* ... and have it preprocessed */
+        /* ... trimmed and merged into the next slots of the batch */
+        if( frontend.batch_N == 0 ) frontend.batch_first = *stamp;
+        for( k = 0; k < n; k++ )
+            batchVectors( frontend.trimmed,
+                          trimPush( &frontend.trimmer, frontend.features + k * FEAT_VEC_SIZE,
+                                    frontend.trimmed ) );
 
-            /* put the resulting feature vector in queue2 using the proper status flag */
+        latencyNow( &frame_end );
+        frames_ms += latencyDiffMs( &frame_start, &frame_end );
 
-            if( P_status == Q_start )
-            {
-                enqueue( &queue2, feat_vector, FEAT_VEC_SIZE, Q_start );
-                //fprintf(stderr, "Start preprocessing!\n");
-                P_status = Q_data;
-            }
-            else if( P_status == Q_end && frameI == frames_N - 1 )
-            {
-                enqueue( &queue2, feat_vector, FEAT_VEC_SIZE, Q_end );
-                setPDone( 1 );
-                //fprintf(stderr, "Done preprocessing!\n");
-            }
-            else
-            {
-                enqueue( &queue2, feat_vector, FEAT_VEC_SIZE, Q_data );
-            }
+        /*
+         * hand a full batch to the recognizer,
+         * unless it is the one that ends the utterance
+         */
+        if( frontend.batch_N >= frontend.batch_max && !( status == Q_end && frameI + n == frames_N ) )
+        {
+            emitBatch( frontend.batch_status, stamp );
+            frontend.batch_status = Q_data;
         }
+    }
+
+    if( frames_N > 0 ) latencyFrontend( frames_N, frames_ms );
 
-        /* there may be remaining data that did not fit in the last frame */
-        remainder = buffer_counter - frames_N * OFFSET;
+    /*
+     * hand over the remaining feature vectors using the proper status flag:
+     * the end of the utterance and its first chunk of audio data are handed over
+     * immediately, so 'start' and 'end' never share a batch
+     */
+    if( status == Q_end )
+    {
+        batchVectors( frontend.trimmed, trimFlush( &frontend.trimmer, frontend.trimmed ) );
+        frontend.batch_N += vfrFlush( &frontend.vfr, frontend.batch + frontend.batch_N * VFR_VEC_SIZE );
 
         /*
-         * move this remaining data to the front of the buffer and adjust the buffer_counter
-         *
-         * use memcpy, if the two memory regions do not overlap, otherwise use for
+         * all of the utterance may have been trimmed away until now:
+         * it still needs its (empty) 'start'-type batch
          */
-        if( remainder < frames_N * OFFSET )
-            memcpy( buffer, buffer + frames_N * OFFSET, remainder );
-        else
-            for( i = 0; i < remainder; i++ )
-                buffer[i] = buffer[i + frames_N * OFFSET];
+        if( frontend.batch_status == Q_start )
+        {
+            int batch_N = frontend.batch_N;
+
+            frontend.batch_N = 0;
+            emitBatch( Q_start, stamp );
+            frontend.batch_N = batch_N;
+            frontend.batch_status = Q_data;
+        }
+
+        latencyMark( L_last_audio, stamp );
+        emitBatch( Q_end, stamp );
+        latencyMark( L_p_done, NULL );
+        setPDone( 1 );
+        frontend.speculate = 0;
+        //fprintf(stderr, "Done preprocessing!\n");
+    }
+    else
+    {
+        if( frontend.batch_N > 0 &&
+            ( frontend.batch_status == Q_start || frame_batch == 0 ||
+              latencyDiffMs( &frontend.batch_first, stamp ) >= batch_latency ) )
+        {
+            emitBatch( frontend.batch_status, stamp );
+            frontend.batch_status = Q_data;
+        }
 
-        buffer_counter = remainder;
+        speculateEnd( stamp );
     }
 
-    endPreprocess(  );
-    /* free any allocated memory etc. */
+    /* data that did not fit in the last frame stays in the framer's ring buffer */
 }
 
-/* find maximum absolute value in buffer */
+/********************************************************************************
+ * preprocessing thread
+ ********************************************************************************/
 
-static inline signed short buf_max( const unsigned char *buf, int len )
+void preprocess( void )
 {
-    signed short max = 0;
-    signed short value;
-    int i;
+    /* size of the current chunk of audio data (the last chunk of an utterance may be short) */
+    int size;
+
+    /* status of current queue item */
+    enum QStatus P_status;
+
+    /* capture time of the current chunk of audio data */
+    struct timespec stamp;
+
+    setupThread( T_preprocess );
 
-    for( i = 0; i < len - 1; i += 2 )
+    if( g_verbose ) printf( "%d: Preprocessing thread started.\n", ( int )syscall( SYS_gettid ) );
+
+    /* main loop of the preprocessing thread */
+    while( running )
     {
-        value = abs( ( signed short )( buf[i] | ( buf[i + 1] << 8 ) ) );
-        if( value > max ) max = value;
+        /*
+         * get head data and status from queue1
+         * (the dequeue function blocks the preprocessing thread if the queue is empty!)
+         */
+        unsigned char *tmp_data = ( unsigned char * )dequeueStamped( &queue1, &P_status, &stamp, &size );
+
+        preprocessChunk( tmp_data, size, P_status, &stamp );
+        free( tmp_data );
+
+        /* the 'exit'-type chunk is the last one, 'running' may not be reset yet */
+        if( P_status == Q_exit ) break;
     }
+}
+
+/********************************************************************************
+ * pass a chunk of audio data on to preprocessing
+ ********************************************************************************/
 
-    return max;
+void handOver( unsigned char *data, int size, enum QStatus status, const struct timespec *stamp )
+{
+    if( single_thread ) preprocessChunk( data, size, status, stamp );
+    else enqueueStamped( &queue1, data, size, status, stamp );
 }
 
 /********************************************************************************
@@ -1342,35 +2030,58 @@ static inline signed short buf_max( const unsigned char *buf, int len )
 void record( void )
 {
     /*
-     * number of incoming blocks that need to be
-     * considered '[not] containing speech' before recording is started
+     * speech/nonspeech detector, works on 10ms hops and
+     * is restarted whenever the audio status changes
      */
-    int count = 0;
+    Vad vad;
+    enum AudioStatus vad_status = A_invalid;
+    enum AudioStatus status;
+
+    /* number of bytes up to the point where speech/silence was detected */
+    int detected;
 
-    /* set prefetch buffer size to 5, and allocate the required memory */
+    /* set prefetch buffer size to (at least) PREFETCH_SIZE bytes, and allocate the required memory */
 
-    int prefetch_N = 5;
+    int prefetch_N = ( PREFETCH_SIZE + frag_size - 1 ) / frag_size;
     int prefetch_pos = 0;
-    unsigned char prefetch[prefetch_N][FRAG_SIZE];
+    unsigned char prefetch[prefetch_N][frag_size];
+    struct timespec prefetch_stamp[prefetch_N];
 
     /*
-     * a buffer of size 'FRAG_SIZE' that contains (raw) audio data which
+     * a buffer of size 'frag_size' that contains (raw) audio data which
      * was recorded from the sound card.
      */
-    unsigned char buffer_raw[FRAG_SIZE];
+    unsigned char buffer_raw[frag_size];
+
+    /* capture time of buffer_raw, and of the last block that contained speech */
+    struct timespec stamp;
+    struct timespec speech_end;
 
     int reset = 1;                               /* first if statement inside while loop initializes the recording */
 
     struct audio_buf_info info;
     int abort_queued = 0;
-    int i;
+    int pause_queued = 0;                        /* 'pause'-type chunk of the current silence handed over */
+    int i, n;
+
+    /* capture time of the previous block, used to detect missed deadlines */
+    struct timespec last_stamp = { 0, 0 };
+
+    setupThread( T_record );
 
     if( g_verbose ) printf( "%d: Listening thread started.\n", syscall( SYS_gettid ) );
 
     if( openAudio(  ) == AUDIO_ERR )
     {
+        /* nobody would ever switch the other threads off, give up right away */
         fprintf( stderr, "AUDIO_ERR\n" );
-        return;
+        exit( -1 );
+    }
+
+    if( !initVad( &vad, frag_size ) )
+    {
+        fprintf( stderr, "Failed to initialize voice detection!\n" );
+        exit( -1 );
     }
 
     /* main loop of the audio recording thread */
@@ -1380,11 +2091,31 @@ void record( void )
         {
             /* pause */
 
-            count = 0;                           /* reset count */
+            vad_status = A_invalid;              /* restart speech detection */
             prefetch_pos = 0;                    /* reset position in audio prefetch buffer */
             abort_queued = 0;
+            pause_queued = 0;
             setAudioStatus( A_off );             /* set status to A_off */
             memset( prefetch, 0, sizeof( prefetch ) );
+            memset( prefetch_stamp, 0, sizeof( prefetch_stamp ) );
+            memset( &last_stamp, 0, sizeof( last_stamp ) );
+
+            /*
+             * in single-thread mode the recognizer has already seen all data:
+             * report its result and switch back to 'auto recording' (or exit) here
+             */
+            if( single_thread )
+            {
+                if( recognizer.done )
+                {
+                    recognizer.done = 0;
+                    if( reportResult(  ) ) setAudioStatus( A_prefetching );
+                    else setAudioStatus( A_exiting );
+                }
+                else
+                    setAudioStatus( A_prefetching );
+                beep(  );
+            }
 
             /* wait at a semaphore for 'auto recording' request */
             waitForAutoRecordingRequest(  );
@@ -1395,17 +2126,42 @@ void record( void )
         }
 
         /* ... read the data from the device */
-        if( readAudio( buffer_raw, FRAG_SIZE ) < 0 )
+        n = readAudio( buffer_raw, frag_size );
+        if( n < 0 )
         {
             fprintf( stderr, "audio device read error!\n" );
             exit( -1 );
         }
+        getCaptureTime( &stamp );
+        cascade.captured += n / 2.0 / RATE;
+
+        /* at the end of the input (file backend) shut down like on request */
+        if( n == 0 ) setAudioStatus( A_exiting );
+
+        /* the next block is due one block duration after the previous one */
+        if( last_stamp.tv_sec != 0 &&
+            latencyDiffMs( &last_stamp, &stamp ) > 1.5 * 1000.0 * frag_size / 2 / RATE )
+            deadlineMissed( D_capture );
+        last_stamp = stamp;
+
+        if( latencyDumpIfRequested( stderr ) )
+        {
+            reportDeadlineMisses( stderr );
+            reportVad( stderr );
+        }
+
+        status = getAudioStatus(  );
+        if( status != vad_status )
+        {
+            resetVad( &vad );
+            vad_status = status;
+        }
 
-        switch ( getAudioStatus(  ) )
+        switch ( status )
         {
             case A_exiting:
                 /* enqueue an 'exit'-type frame into queue1 */
-                enqueue( &queue1, buffer_raw, FRAG_SIZE, Q_exit );
+                handOver( buffer_raw, frag_size, Q_exit, &stamp );
                 running = 0;
                 break;
 
@@ -1418,38 +2174,45 @@ void record( void )
                 /* enqueue an 'abort'-type frame into queue1 */
                 if( !abort_queued )
                 {
-                    enqueue( &queue1, buffer_raw, FRAG_SIZE, Q_abort );
+                    handOver( buffer_raw, frag_size, Q_abort, &stamp );
                     abort_queued = 1;
                 }
 
                 /* wait for audio signal to fall back to silence!! */
 
-                if( buf_max( buffer_raw, FRAG_SIZE ) <= stop_level ) count++;
-                else count = 0;
-
-                if( count >= CONSECUTIVE_NONSPEECH_BLOCKS_THRESHOLD ) reset = 1;
+                if( detectSilence( &vad, buffer_raw, frag_size ) ) reset = 1;
 
                 break;
 
             case A_prefetching:
+                if( keyword_spotting )
+                {
+                    /* the whole stream is one utterance, it starts right away */
+                    latencyReset(  );
+                    handOver( buffer_raw, frag_size, Q_start, &stamp );
+                    setAudioStatus( A_recording );
+                    break;
+                }
+
                 /* prefetch data into a circular buffer ... */
-                memcpy( prefetch[prefetch_pos], buffer_raw, FRAG_SIZE );
+                memcpy( prefetch[prefetch_pos], buffer_raw, frag_size );
+                prefetch_stamp[prefetch_pos] = stamp;
                 prefetch_pos = ( prefetch_pos + 1 ) % prefetch_N;
 
                 /* and check it for speech content */
 
-                if( buf_max( buffer_raw, FRAG_SIZE ) >= rec_level ) count++;
-                else count = 0;
-
-                if( count >= CONSECUTIVE_SPEECH_BLOCKS_THRESHOLD )  /* if speech detected ... */
+                if( detectSpeech( &vad, buffer_raw, frag_size ) )  /* if speech detected ... */
                 {
-                    count = 0;
+                    latencyReset(  );
+                    latencyMark( L_vad_trigger, &stamp );
+                    speech_end = stamp;
 
                     /* ... extract the data from the prefetch buffer and insert it into queue1 */
 
                     for( i = prefetch_pos; i < prefetch_pos + prefetch_N; i++ )
-                        enqueue( &queue1, prefetch[i % prefetch_N], FRAG_SIZE,
-                                 ( i == prefetch_pos ? Q_start : Q_data ) );
+                        handOver( prefetch[i % prefetch_N], frag_size,
+                                  ( i == prefetch_pos ? Q_start : Q_data ),
+                                  &prefetch_stamp[i % prefetch_N] );
 
                     /* ... start recording, ...  */
 
@@ -1458,32 +2221,56 @@ void record( void )
                 break;
 
             case A_recording:                   /* currently recording audio data ... */
+                if( keyword_spotting )
+                {
+                    handOver( buffer_raw, frag_size, Q_data, &stamp );
+                    break;
+                }
+
                 /* check whether no more speech signal, then stop recording */
 
-                if( buf_max( buffer_raw, FRAG_SIZE ) <= stop_level ) count++;
-                else count = 0;
+                detected = detectSilence( &vad, buffer_raw, frag_size );
+                if( vad.interrupted )
+                {
+                    speech_end = stamp;
+                    pause_queued = 0;
+                }
 
                 /*
-                 * recording will be stopped,
-                 * if more than a predefined number of non-speech blocks come in a row
+                 * recording will be stopped right after the hop at which
+                 * the silence hangover has passed
                  */
 
-                if( count >= CONSECUTIVE_NONSPEECH_BLOCKS_THRESHOLD )
+                if( detected )
                 {
-                    /* here we insert the last data chunk into queue1 */
-                    enqueue( &queue1, buffer_raw, FRAG_SIZE, Q_end );
+                    /*
+                     * here we insert the last (partial) data chunk into queue1,
+                     * at least one hop is needed so that preprocessing gets one more frame
+                     */
+                    if( detected < OFFSET ) detected = OFFSET;
+                    latencyAddMs( &stamp, -1000.0 * ( frag_size - detected ) / 2 / RATE );
+
+                    latencyMark( L_speech_end, &speech_end );
+                    handOver( buffer_raw, detected, Q_end, &stamp );
 
                     /* turn off recognition */
                     reset = 1;
                 }
+                else if( vad.count > 0 && !pause_queued )
+                {
+                    /* speech has stopped: the recognizer may prepare for the end (see speculate()) */
+                    handOver( buffer_raw, frag_size, Q_pause, &stamp );
+                    pause_queued = 1;
+                }
                 else
                 {
                     /* insert the current chunk of data into queue1 */
-                    enqueue( &queue1, buffer_raw, FRAG_SIZE, Q_data );
+                    handOver( buffer_raw, frag_size, Q_data, &stamp );
                 }
                 break;
         }
     }
 
+    endVad( &vad );
     closeAudio(  );
 }
@@ -96,6 +96,27 @@ int sloppy_corner;
   *****/
 float score_threshold;
 
+/*****
+  early decision: a reference is recognized before the end of the
+  utterance once its open-end score leads the ones of all other
+  references (at least one of them still active) by at least
+  early_margin (0 = off) for early_frames (10 ms) frames, see
+  earlyDecision()
+  *****/
+extern float early_margin;
+extern int early_frames;
+
+/*****
+  wake word cascade (off if wake_group is empty): while it is not armed,
+  only the references of group wake_group (see model.h) are matched, with
+  wake_threshold in place of score_threshold. Recognizing one of them arms
+  the full model (the current context) for the utterances that start
+  within wake_time ms, each command it recognizes extends this time.
+  *****/
+extern char wake_group[];
+extern float wake_threshold;
+extern int wake_time;
+
 /*****
   a (very high) float value that is considered "infinity"
   *****/
@@ -114,7 +135,15 @@ float float_max;
  * preprocessing variables
  ********************************************************************************/
 
-/* (none) */
+/*****
+  feature vectors are handed to the recognizer in batches:
+  frame_batch is the number of feature vectors per batch
+  (0 = all feature vectors of one fragment of audio data),
+  batch_latency is the time (in ms) after which an incomplete
+  batch is handed over anyway
+  *****/
+extern int frame_batch;
+extern int batch_latency;
 
 /********************************************************************************
  * recording variables
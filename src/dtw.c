@@ -0,0 +1,246 @@
+/***************************************************************************
+                          dtw.c  -  DTW of a test utterance against
+                                    a sample utterance
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <math.h>
+#include <float.h>
+
+#include "cvoicecontrol.h"
+#include "dtw.h"
+#include "vfr.h"
+
+/********************************************************************************
+ * set the parameters of the warping (see cvoicecontrol.h)
+ ********************************************************************************/
+
+void initDtw(  )
+{
+    /* adjust_win_width and score_threshold should be put in a config file type of place */
+    adjust_window_width = 90;
+    sloppy_corner = SAMPLE_MIN_LENGTH - 1;
+    /* score_threshold = 18; */
+    float_max = FLT_MAX * 0.0001;
+}
+
+/********************************************************************************
+ * calculate euklidian distance of two feature vectors
+ ********************************************************************************/
+
+float euklid_distance( float *a, float *b )
+{
+    float result = 0;                            /* resulting distance */
+    int i;
+    /*
+     * sum up the squares of the differences of the vector's components
+     * the result is the square root of this value
+     */
+    for( i = 0; i < FEAT_VEC_SIZE; i++ ) result += ( a[i] - b[i] ) * ( a[i] - b[i] );
+    result = sqrt( result );
+    return result;
+}
+
+/********************************************************************************
+ * calculate the rows bottom .. top-1 of DTW column 'pos' (pos > 1) of a sample
+ * utterance using the full warping function (see cvoicecontrol.h).
+ * 'frame' is the feature vector at 'pos', 'last_frame' the one at 'pos-1'.
+ * returns the minimum distance in these rows, or 'min_dist' if that is smaller
+ *
+ * Each step of a path counts the distance it ends at once for every frame it
+ * advances by: a diagonal step by the weights of the test and the sample
+ * vector (2 without frame merging), any other step by the weight of the one
+ * vector it advances. Paths are normalized by the sum of the times.
+ ********************************************************************************/
+
+float dtwRows( ModelItemSample *sample, int pos, int bottom, int top, float *frame,
+               float *last_frame, float min_dist )
+{
+    float *column = sample->matrix[pos % 3];
+    float *column_1 = sample->matrix[( pos - 1 ) % 3];
+    float *column_2 = sample->matrix[( pos - 2 ) % 3];
+    float *weight = sample->weight;
+    float w = frame[VFR_WEIGHT], w_1 = last_frame[VFR_WEIGHT];
+    float act_dist, tmp_dist;
+    int j;
+
+    for( j = bottom; j < top; j++ )
+    {
+        act_dist = euklid_distance( sample->data[j], frame );
+
+        if( column_1[j - 1] < float_max || column_1[j - 2] < float_max ||
+            column_2[j - 1] < float_max )
+        {
+            column[j] = MIN3( column_1[j - 1] + ( w + weight[j] ) * act_dist,
+                              column_1[j - 2] +
+                              ( w + weight[j - 1] ) * euklid_distance( sample->data[j - 1], frame ) +
+                              weight[j] * act_dist,
+                              column_2[j - 1] +
+                              ( w_1 + weight[j] ) * euklid_distance( sample->data[j], last_frame ) +
+                              w * act_dist );
+
+            tmp_dist = column[j] / ( frame[VFR_TIME] + sample->time[j] );
+            if( tmp_dist < min_dist )
+                min_dist = tmp_dist;
+        }
+        else
+            column[j] = float_max;
+    }
+
+    return min_dist;
+}
+
+/********************************************************************************
+ * calculate DTW column 'pos' of a sample utterance, 'frame' is the feature
+ * vector at 'pos', 'last_frame' the one at 'pos-1' (unused if pos == 0).
+ * returns the minimum distance in the column
+ ********************************************************************************/
+
+float dtwColumn( ModelItemSample *sample, int pos, float *frame, float *last_frame )
+{
+    float *column = sample->matrix[pos % 3];
+    float *weight = sample->weight, *time = sample->time;
+    float w = frame[VFR_WEIGHT], t = frame[VFR_TIME];
+    float column_min_dist = float_max;
+    float act_dist, tmp_dist;
+    int i;
+
+    /* initialize current DTW matrix column, i.e. set all values to 'infinity' */
+
+    for( i = 0; i < sample->length; i++ )
+        column[i] = float_max;
+
+    if( pos == 0 )
+        /* at pos == 0, we initialize the first matrix column */
+    {
+        /* calculate the first <sloppy_corner> items in the current column */
+
+        column[0] = ( w + weight[0] ) * euklid_distance( sample->data[0], frame );
+        column_min_dist = column[0] / ( t + time[0] );
+
+        for( i = 1; i < sloppy_corner; i++ )
+        {
+            column[i] = column[i - 1] + weight[i] * euklid_distance( sample->data[i], frame );
+
+            tmp_dist = column[i] / ( t + time[i] );
+            if( tmp_dist < column_min_dist )
+                column_min_dist = tmp_dist;
+        }
+    }
+    else if( pos == 1 )
+    {
+        /*
+         * at pos == 1, we use a special (shorter) warping function
+         * as the history (of one matrix column) does not allow
+         * for the application of the full warping function yet
+         */
+        float *column_1 = sample->matrix[0];
+
+        column[0] = column_1[0] + w * euklid_distance( sample->data[0], frame );
+        column_min_dist = column[0] / ( t + time[0] );
+
+        act_dist = euklid_distance( sample->data[1], frame );
+        column[1] = MIN3( column_1[1] + w * act_dist, column[0] + weight[1] * act_dist,
+                          column_1[0] + ( w + weight[1] ) * act_dist );
+
+        tmp_dist = column[1] / ( t + time[1] );
+        if( tmp_dist < column_min_dist )
+            column_min_dist = tmp_dist;
+
+        for( i = 2; i < sloppy_corner + 1; i++ )
+        {
+            act_dist = euklid_distance( sample->data[i], frame );
+
+            column[i] = MIN3( column_1[i] + w * act_dist,
+                              column_1[i - 1] + ( w + weight[i] ) * act_dist,
+                              column_1[i - 2] +
+                              ( w + weight[i - 1] ) * euklid_distance( sample->data[i - 1], frame ) +
+                              weight[i] * act_dist );
+
+            tmp_dist = column[i] / ( t + time[i] );
+            if( tmp_dist < column_min_dist )
+                column_min_dist = tmp_dist;
+        }
+    }
+    else
+    {
+        /*
+         * beyond pos == 1, the warping function lies inside the matrix
+         * and can be calculated completely.
+         */
+        float *column_1 = sample->matrix[( pos - 1 ) % 3];
+        float *column_2 = sample->matrix[( pos - 2 ) % 3];
+
+        /* take care of sloppy start */
+
+        if( pos < sloppy_corner )
+            /* element in first row of DTW matrix */
+        {
+            column[0] = column_1[0] + w * euklid_distance( sample->data[0], frame );
+            column_min_dist = column[0] / ( t + time[0] );
+        }
+        if( pos < sloppy_corner + 1 )
+            /* element in second row of DTW matrix */
+        {
+            act_dist = euklid_distance( sample->data[1], frame );
+
+            /* use a simpler, smaller warping function that fits into the DTW matrix */
+
+            column[1] = MIN3( column[0] + weight[1] * act_dist,
+                              column_1[0] + ( w + weight[1] ) * act_dist,
+                              column_2[0] +
+                              ( last_frame[VFR_WEIGHT] + weight[1] ) *
+                              euklid_distance( sample->data[1], last_frame ) + w * act_dist );
+
+            tmp_dist = column[1] / ( t + time[1] );
+            if( tmp_dist < column_min_dist )
+                column_min_dist = tmp_dist;
+        }
+
+        /*
+         * loop rows in current DTW column within
+         * - range of adjust_window,
+         * - range of warping function
+         * - sample length
+         */
+        column_min_dist =
+            dtwRows( sample, pos, MAX3( 2, pos - adjust_window_width, ( pos - 2 ) / 2 ),
+                     MIN3( sloppy_corner + 1 + ( pos - 1 ) * 2, sample->length,
+                           pos + adjust_window_width ), frame, last_frame, column_min_dist );
+    }
+
+    return column_min_dist;
+}
+
+/********************************************************************************
+ * score of a sample utterance whose last DTW column is 'pos', 'time' is the
+ * time of the test vector at 'pos'. The score is taken from the upper right
+ * (sloppy) corner of the DTW matrix, normalized by one less than the times.
+ ********************************************************************************/
+
+float dtwScore( ModelItemSample *sample, int pos, float time )
+{
+    float *column = sample->matrix[pos % 3];
+    float score = column[sample->length - 1] / ( time + sample->time[sample->length - 1] - 1 );
+    float tmp_dist;
+    int s;
+
+    for( s = 1; s < sloppy_corner; s++ )
+    {
+        tmp_dist = column[sample->length - 1 - s] / ( time + sample->time[sample->length - 1 - s] - 1 );
+        if( tmp_dist < score )
+            score = tmp_dist;
+    }
+
+    return score;
+}
@@ -0,0 +1,38 @@
+/***************************************************************************
+                          dtw.h  -  DTW of a test utterance against
+                                    a sample utterance
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef DTW_H
+#define DTW_H
+
+#include "model.h"
+
+/********************************************************************************
+ * The DTW matrix of a sample utterance is calculated column by column, one
+ * column per (merged, see vfr.h) feature vector of the test utterance, in
+ * the three columns of sample->matrix. The warping function is described
+ * in cvoicecontrol.h. These functions are shared by the recognizer and the
+ * tools that align the sample utterances of a model with each other.
+ ********************************************************************************/
+
+void  initDtw(  );
+
+float euklid_distance( float *a, float *b );
+float dtwRows( ModelItemSample *sample, int pos, int bottom, int top, float *frame,
+               float *last_frame, float min_dist );
+float dtwColumn( ModelItemSample *sample, int pos, float *frame, float *last_frame );
+float dtwScore( ModelItemSample *sample, int pos, float time );
+
+#endif
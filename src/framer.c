@@ -0,0 +1,134 @@
+/***************************************************************************
+                          framer.c  -  cuts a stream of audio data into
+                                       overlapping, windowed frames
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "preprocess.h"
+#include "framer.h"
+
+/********************************************************************************
+ * initialize a framer that can take chunks of up to 'chunk_size' bytes
+ * between two rounds of taking frames and multiplies each frame with
+ * 'window' (which has to stay around), returns 0 on error
+ ********************************************************************************/
+
+int initFramer( Framer *framer, int chunk_size, const float *window )
+{
+    framer->window = window;
+
+    /* room for a whole chunk plus the samples kept for the next frame */
+    framer->size = 1;
+    while( framer->size < chunk_size / 2 + FFT_SIZE ) framer->size <<= 1;
+
+    framer->ring = ( float * )malloc( sizeof( float ) * framer->size );
+    framer->write = framer->read = 0;
+
+    if( framer->ring == NULL )
+    {
+        fprintf( stderr, "Error allocating memory for framer.\n" );
+        return 0;
+    }
+    return 1;
+}
+
+/********************************************************************************
+ * drop all samples, e.g. at the start of a new utterance
+ ********************************************************************************/
+
+void resetFramer( Framer *framer )
+{
+    framer->write = framer->read = 0;
+}
+
+/********************************************************************************
+ * free the memory of a framer
+ ********************************************************************************/
+
+void endFramer( Framer *framer )
+{
+    free( framer->ring );
+    framer->ring = NULL;
+}
+
+/********************************************************************************
+ * convert (up to) 'size' bytes of audio data into the ring buffer,
+ * returns the number of bytes taken (less than 'size' if the ring is full,
+ * take frames and push the rest then)
+ ********************************************************************************/
+
+int framerPush( Framer *framer, const unsigned char *data, int size )
+{
+    unsigned int mask = framer->size - 1;
+    int n = size / 2;
+    int start, first, i;
+
+    if( n > ( int )( framer->size - ( framer->write - framer->read ) ) )
+        n = framer->size - ( framer->write - framer->read );
+
+    /* two contiguous runs: up to the end of the ring, then from its start */
+
+    start = framer->write & mask;
+    first = framer->size - start;
+    if( first > n ) first = n;
+
+    for( i = 0; i < first; i++ )
+        framer->ring[start + i] = ( float )( signed short )( data[2 * i] | ( data[2 * i + 1] << 8 ) );
+    for( ; i < n; i++ )
+        framer->ring[i - first] = ( float )( signed short )( data[2 * i] | ( data[2 * i + 1] << 8 ) );
+
+    framer->write += n;
+
+    return 2 * n;
+}
+
+/********************************************************************************
+ * number of frames that can be taken right now
+ ********************************************************************************/
+
+int framerFrames( const Framer *framer )
+{
+    unsigned int available = framer->write - framer->read;
+
+    if( available < FFT_SIZE ) return 0;
+    return ( available - FFT_SIZE ) / ( OFFSET / 2 ) + 1;
+}
+
+/********************************************************************************
+ * take the next windowed frame (FFT_SIZE values),
+ * returns 0 if not enough samples have been pushed yet
+ ********************************************************************************/
+
+int framerFrame( Framer *framer, float *frame )
+{
+    unsigned int mask = framer->size - 1;
+    int start, first, i;
+
+    if( framer->write - framer->read < FFT_SIZE ) return 0;
+
+    start = framer->read & mask;
+    first = framer->size - start;
+    if( first > FFT_SIZE ) first = FFT_SIZE;
+
+    for( i = 0; i < first; i++ )
+        frame[i] = framer->ring[start + i] * framer->window[i];
+    for( ; i < FFT_SIZE; i++ )
+        frame[i] = framer->ring[i - first] * framer->window[i];
+
+    framer->read += OFFSET / 2;
+
+    return 1;
+}
@@ -0,0 +1,52 @@
+/***************************************************************************
+                          framer.h  -  cuts a stream of audio data into
+                                       overlapping, windowed frames
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef FRAMER_H
+#define FRAMER_H
+
+/********************************************************************************
+ * streaming framer: turns 16 bit little endian audio data, pushed in chunks
+ * of any even size, into hamming windowed frames of FFT_SIZE samples,
+ * one every OFFSET bytes (10 ms).
+ *
+ * Each sample is converted to float once, when it is pushed, and stays
+ * in a ring buffer until the last frame that contains it has been taken.
+ * The counters wrap around, only their difference is meaningful.
+ *
+ * window window function the frames are multiplied with (FFT_SIZE values)
+ * ring   converted samples ('size' of them, a power of two)
+ * write  number of samples pushed so far
+ * read   first sample of the next frame
+ ********************************************************************************/
+
+typedef struct
+{
+    const float *window;
+    float *ring;
+    unsigned int size;
+    unsigned int write;
+    unsigned int read;
+} Framer;
+
+int  initFramer( Framer *framer, int chunk_size, const float *window );
+void resetFramer( Framer *framer );
+void endFramer( Framer *framer );
+
+int  framerPush( Framer *framer, const unsigned char *data, int size );
+int  framerFrames( const Framer *framer );
+int  framerFrame( Framer *framer, float *frame );
+
+#endif
@@ -0,0 +1,311 @@
+/***************************************************************************
+                          latency.c  -  end-to-end latency instrumentation
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "latency.h"
+
+/********************************************************************************
+ * the spans a per-utterance breakdown is made of. Each span is kept in a
+ * ring buffer of the last LATENCY_WINDOW values for the percentile report.
+ ********************************************************************************/
+
+enum LatencySpan {
+    S_hangover,                                  /* speech end -> last audio */
+    S_preprocess,                                /* last audio -> P_done */
+    S_drain,                                     /* P_done -> B&B switch */
+    S_decode,                                    /* B&B switch (or P_done) -> result */
+    S_dispatch,                                  /* result -> command start */
+    S_total,                                     /* speech end -> command start (or result) */
+    S_command,                                   /* VAD trigger -> command start (or result) */
+    S_frame_age,                                 /* capture -> dequeue in recognizer, per frame */
+    S_number_of_spans
+};
+
+static const char *span_name[S_number_of_spans] = {
+    "hangover", "preprocess", "drain", "decode", "dispatch", "total", "command", "frame age"
+};
+
+static int enabled = 0;                          /* print per-utterance breakdowns */
+
+static pthread_mutex_t mutex_latency = PTHREAD_MUTEX_INITIALIZER;
+
+static struct timespec marks[L_number_of_events];
+static int is_marked[L_number_of_events];
+
+static float window[S_number_of_spans][LATENCY_WINDOW];
+static int window_pos[S_number_of_spans];
+static int window_count[S_number_of_spans];
+
+static volatile sig_atomic_t dump_requested = 0;
+
+/* time spent in the front end (framing and preprocessing) and number of frames */
+
+static double frontend_ms = 0;
+static long frontend_frames = 0;
+
+/********************************************************************************
+ * initialize latency bookkeeping
+ ********************************************************************************/
+
+void latencyInit( int report )
+{
+    pthread_mutex_lock( &mutex_latency );
+    enabled = report;
+    memset( is_marked, 0, sizeof( is_marked ) );
+    memset( window_pos, 0, sizeof( window_pos ) );
+    memset( window_count, 0, sizeof( window_count ) );
+    frontend_ms = 0;
+    frontend_frames = 0;
+    pthread_mutex_unlock( &mutex_latency );
+}
+
+int latencyEnabled(  )
+{
+    return enabled;
+}
+
+/********************************************************************************
+ * current time of the monotonic clock
+ ********************************************************************************/
+
+void latencyNow( struct timespec *ts )
+{
+    clock_gettime( CLOCK_MONOTONIC, ts );
+}
+
+/********************************************************************************
+ * difference 'to - from' in milliseconds
+ ********************************************************************************/
+
+double latencyDiffMs( const struct timespec *from, const struct timespec *to )
+{
+    return ( to->tv_sec - from->tv_sec ) * 1000.0 + ( to->tv_nsec - from->tv_nsec ) / 1000000.0;
+}
+
+/********************************************************************************
+ * move a time stamp by 'ms' milliseconds
+ ********************************************************************************/
+
+void latencyAddMs( struct timespec *ts, double ms )
+{
+    long long ns = ts->tv_sec * 1000000000LL + ts->tv_nsec + ( long long )( ms * 1000000.0 );
+
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+/* add a value to the ring buffer of a span (mutex must be held) */
+
+static void addToWindow( enum LatencySpan s, float value )
+{
+    window[s][window_pos[s]] = value;
+    window_pos[s] = ( window_pos[s] + 1 ) % LATENCY_WINDOW;
+    if( window_count[s] < LATENCY_WINDOW ) window_count[s]++;
+}
+
+/********************************************************************************
+ * forget the events of the previous utterance
+ ********************************************************************************/
+
+void latencyReset(  )
+{
+    pthread_mutex_lock( &mutex_latency );
+    memset( is_marked, 0, sizeof( is_marked ) );
+    pthread_mutex_unlock( &mutex_latency );
+}
+
+/********************************************************************************
+ * record an event of the current utterance, 'ts == NULL' means 'now'
+ ********************************************************************************/
+
+void latencyMark( enum LatencyEvent e, const struct timespec *ts )
+{
+    struct timespec now;
+
+    if( ts == NULL )
+    {
+        latencyNow( &now );
+        ts = &now;
+    }
+
+    pthread_mutex_lock( &mutex_latency );
+    marks[e] = *ts;
+    is_marked[e] = 1;
+    pthread_mutex_unlock( &mutex_latency );
+}
+
+/********************************************************************************
+ * account for the age of a feature frame when it reaches the recognizer
+ ********************************************************************************/
+
+void latencyFrameAge( const struct timespec *ts )
+{
+    struct timespec now;
+
+    if( ts->tv_sec == 0 && ts->tv_nsec == 0 ) return;   /* frame carries no time stamp */
+
+    latencyNow( &now );
+
+    pthread_mutex_lock( &mutex_latency );
+    addToWindow( S_frame_age, latencyDiffMs( ts, &now ) );
+    pthread_mutex_unlock( &mutex_latency );
+}
+
+/********************************************************************************
+ * account for the time (in ms) the front end needed to compute 'frames' feature frames
+ ********************************************************************************/
+
+void latencyFrontend( int frames, double ms )
+{
+    pthread_mutex_lock( &mutex_latency );
+    frontend_ms += ms;
+    frontend_frames += frames;
+    pthread_mutex_unlock( &mutex_latency );
+}
+
+/* duration of a span between two events, -1 if either of them is missing */
+
+static float span( enum LatencyEvent from, enum LatencyEvent to )
+{
+    if( !is_marked[from] || !is_marked[to] ) return -1;
+    return latencyDiffMs( &marks[from], &marks[to] );
+}
+
+/********************************************************************************
+ * finish the current utterance: add its spans to the rolling windows
+ * and print its breakdown if requested
+ ********************************************************************************/
+
+void latencyCommit(  )
+{
+    float value[S_number_of_spans];
+    enum LatencyEvent decode_start, total_end;
+    int s;
+
+    pthread_mutex_lock( &mutex_latency );
+
+    /* an early decision (see earlyDecision()) comes before the end of the utterance */
+
+    if( !is_marked[L_vad_trigger] || !is_marked[L_result] )
+    {
+        pthread_mutex_unlock( &mutex_latency );
+        return;                                  /* aborted or incomplete utterance */
+    }
+
+    decode_start = is_marked[L_bb_switch] ? L_bb_switch : L_p_done;
+    total_end = is_marked[L_command] ? L_command : L_result;
+
+    value[S_hangover] = span( L_speech_end, L_last_audio );
+    value[S_preprocess] = span( L_last_audio, L_p_done );
+    value[S_drain] = span( L_p_done, L_bb_switch );
+    value[S_decode] = span( decode_start, L_result );
+    value[S_dispatch] = span( L_result, L_command );
+    value[S_total] = span( L_speech_end, total_end );
+    value[S_command] = span( L_vad_trigger, total_end );
+
+    for( s = 0; s < S_frame_age; s++ )
+        if( value[s] >= 0 ) addToWindow( s, value[s] );
+
+    if( enabled )
+    {
+        if( is_marked[L_last_audio] )
+            fprintf( stderr, "latency [ms]: trigger %+.1f", span( L_last_audio, L_vad_trigger ) );
+        else
+            fprintf( stderr, "latency [ms]: trigger -" );
+        for( s = 0; s < S_frame_age; s++ )
+        {
+            if( value[s] >= 0 ) fprintf( stderr, ", %s %.1f", span_name[s], value[s] );
+            else fprintf( stderr, ", %s -", span_name[s] );
+        }
+        fprintf( stderr, "\n" );
+    }
+
+    memset( is_marked, 0, sizeof( is_marked ) );
+
+    pthread_mutex_unlock( &mutex_latency );
+}
+
+/********************************************************************************
+ * async-signal-safe request to dump the percentiles (e.g. from SIGUSR1),
+ * the dump itself is done by a thread calling latencyDumpIfRequested()
+ ********************************************************************************/
+
+void latencyRequestDump(  )
+{
+    dump_requested = 1;
+}
+
+int latencyDumpIfRequested( FILE *f )
+{
+    if( !dump_requested ) return 0;
+    dump_requested = 0;
+    latencyDump( f );
+    return 1;
+}
+
+static int compareFloat( const void *a, const void *b )
+{
+    float x = *( const float * )a, y = *( const float * )b;
+    return ( x > y ) - ( x < y );
+}
+
+/* value at quantile 'q' of 'n' sorted values */
+
+static float quantile( const float *sorted, int n, float q )
+{
+    int i = ( int )( q * n + 0.999999 ) - 1;
+    if( i < 0 ) i = 0;
+    if( i >= n ) i = n - 1;
+    return sorted[i];
+}
+
+/********************************************************************************
+ * print p50/p95/p99 of all spans over the last LATENCY_WINDOW utterances
+ ********************************************************************************/
+
+void latencyDump( FILE *f )
+{
+    float sorted[LATENCY_WINDOW];
+    int s, n;
+
+    pthread_mutex_lock( &mutex_latency );
+
+    fprintf( f, "%-12s %6s %9s %9s %9s\n", "latency [ms]", "n", "p50", "p95", "p99" );
+    for( s = 0; s < S_number_of_spans; s++ )
+    {
+        n = window_count[s];
+        if( n == 0 )
+        {
+            fprintf( f, "%-12s %6d %9s %9s %9s\n", span_name[s], 0, "-", "-", "-" );
+            continue;
+        }
+        memcpy( sorted, window[s], n * sizeof( float ) );
+        qsort( sorted, n, sizeof( float ), compareFloat );
+        fprintf( f, "%-12s %6d %9.1f %9.1f %9.1f\n", span_name[s], n,
+                 quantile( sorted, n, 0.50 ), quantile( sorted, n, 0.95 ),
+                 quantile( sorted, n, 0.99 ) );
+    }
+
+    if( frontend_frames > 0 )
+        fprintf( f, "front end: %ld frames, %.2f us/frame\n", frontend_frames,
+                 1000.0 * frontend_ms / frontend_frames );
+
+    pthread_mutex_unlock( &mutex_latency );
+}
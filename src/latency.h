@@ -0,0 +1,68 @@
+/***************************************************************************
+                          latency.h  -  end-to-end latency instrumentation
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <time.h>
+
+/********************************************************************************
+ * events recorded for every utterance, all of them are taken
+ * from the monotonic clock (CLOCK_MONOTONIC):
+ *
+ * L_vad_trigger  capture time of the block that started recording
+ * L_speech_end   capture time of the last block that was above stop_level
+ * L_last_audio   capture time of the 'end'-type block (hangover passed)
+ * L_p_done       preprocessing of the utterance finished
+ * L_bb_switch    recognizer switched to branch&bound decoding
+ * L_result       recognition result is available
+ * L_command      command is about to be started
+ ********************************************************************************/
+
+enum LatencyEvent {
+    L_vad_trigger,
+    L_speech_end,
+    L_last_audio,
+    L_p_done,
+    L_bb_switch,
+    L_result,
+    L_command,
+    L_number_of_events
+};
+
+/********************************************************************************
+ * number of utterances kept for the rolling percentiles
+ ********************************************************************************/
+
+#define LATENCY_WINDOW 256
+
+void latencyInit( int report );
+int  latencyEnabled(  );
+void latencyNow( struct timespec *ts );
+double latencyDiffMs( const struct timespec *from, const struct timespec *to );
+void latencyAddMs( struct timespec *ts, double ms );
+
+void latencyReset(  );
+void latencyMark( enum LatencyEvent e, const struct timespec *ts );
+void latencyFrameAge( const struct timespec *ts );
+void latencyFrontend( int frames, double ms );
+void latencyCommit(  );
+
+void latencyRequestDump(  );
+int  latencyDumpIfRequested( FILE *f );
+void latencyDump( FILE *f );
+
+#endif
@@ -1020,6 +1020,55 @@ int estimateChannelMean()
   return(retval);
 }
 
+/********************************************************************************
+ * read the lines of config file 'config_file' that microphone_config does
+ * not set (the other options of cvoicecontrol), so that saving the
+ * configuration keeps them. returns them as one string (to be freed),
+ * NULL if there are none or the file can't be read
+ ********************************************************************************/
+
+char *otherConfigLines(char *config_file)
+{
+  static char *own[] = { "Mixer Device", "Audio Device", "Mic Level", "IGain Level", "Record Level",
+			 "Stop Level", "Silence Level", "Channel Mean", NULL };
+
+  FILE *f = fopen(config_file, "r");
+  char s[500], *lines = NULL;
+  int length = 0, line_start = 1, keep = 0, i;
+
+  if (f == NULL)
+    return NULL;
+
+  while (fgets(s, sizeof(s), f) != NULL)
+  {
+    /***** a line longer than 's' is read in pieces, its first one decides */
+
+    if (line_start)
+    {
+      for (i = 0; own[i] != NULL; i++)
+	if (strncmp(s, own[i], strlen(own[i])) == 0)
+	  break;
+      keep = own[i] == NULL;
+    }
+    line_start = s[strlen(s)-1] == '\n';
+
+    if (keep)
+    {
+      lines = (char *)realloc(lines, length + strlen(s) + 2);
+      strcpy(lines + length, s);
+      length += strlen(s);
+    }
+  }
+  fclose(f);
+
+  /***** the last line may lack its newline */
+
+  if (lines != NULL && lines[length-1] != '\n')
+    strcpy(lines + length, "\n");
+
+  return lines;
+}
+
 /********************************************************************************
  * save configuration
  ********************************************************************************/
@@ -1099,6 +1148,10 @@ int saveConfiguration()
   strcpy(config_file, config_dir);
   strcat(config_file, "/config");
 
+  /***** the other options in the config file are written back after the ones set here */
+
+  char *other_lines = otherConfigLines(config_file);
+
     FILE *f = fopen( config_file, "w" );
 
   if( !f ) /***** failed to write config file */
@@ -1113,6 +1166,7 @@ int saveConfiguration()
     wrefresh (savescr);     /***** refresh the dialog */
     getch();                /***** wait for keyboard reaction */
 
+    free(other_lines);
     retval = 0;  /***** set return value to ERROR */
     goto saveConfigurationReturn;
   }
@@ -1130,7 +1184,10 @@ int saveConfiguration()
   for (i = 0; i < FEAT_VEC_SIZE; i++)
     fprintf(f, " %6.5f", channel_mean[i]);
   fprintf(f, "\n");
+  if (other_lines != NULL)
+    fputs(other_lines, f);
   fclose(f);
+  free(other_lines);
 
   /***** clear dialog */
 
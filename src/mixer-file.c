@@ -0,0 +1,116 @@
+/***************************************************************************
+                          mixer-file.c  -  mixer of the file/pipe audio
+                                           backend (there is none)
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mixer.h"
+
+int mic_level;
+int igain_level;
+static char *dev_mixer = NULL;
+
+/********************************************************************************
+ * set mixer device name
+ ********************************************************************************/
+
+void setMixer(char *dev)
+{
+    if( !dev ) return;
+    if( dev_mixer ) free( dev_mixer );
+    dev_mixer = strdup( dev );
+}
+
+/********************************************************************************
+ * deselect any selected mixer device
+ ********************************************************************************/
+
+void noMixer()
+{
+    if( dev_mixer ) free(dev_mixer);
+    dev_mixer = NULL;
+}
+
+/********************************************************************************
+ * get mixer device name
+ ********************************************************************************/
+
+const char *getMixer()
+{
+    return dev_mixer;
+}
+
+/********************************************************************************
+ * tells whether the mixer variable has been set
+ ********************************************************************************/
+
+int mixerOK()
+{
+    return dev_mixer ? MIXER_OK : MIXER_ERR;
+}
+
+/********************************************************************************
+ * tells whether the mixer has an input gain channel
+ ********************************************************************************/
+
+int mixerHasIGain()
+{
+    return MIXER_ERR;
+}
+
+/********************************************************************************
+ * check mixer capabilities and initialize mixer
+ ********************************************************************************/
+
+int initMixer()
+{
+    return MIXER_OK;
+}
+
+/********************************************************************************
+ * return a list of available mixer devices
+ ********************************************************************************/
+
+MixerDevices *scanMixerDevices()
+{
+    MixerDevices *devices;
+    devices          = malloc(sizeof(MixerDevices));
+    devices->name    = malloc((sizeof (char *)));
+    devices->name[0] = strdup( "none" );
+    devices->count   = 1;
+    return devices;
+}
+
+/********************************************************************************
+ * set level of microphone channel (the level is only remembered,
+ * recorded data is never scaled)
+ ********************************************************************************/
+
+int setMicLevel( int level )
+{
+    mic_level = level;
+    return MIXER_OK;
+}
+
+/********************************************************************************
+ * set level of input gain channel
+ ********************************************************************************/
+
+int setIGainLevel(int level)
+{
+    igain_level = level;
+    return MIXER_OK;
+}
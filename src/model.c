@@ -22,6 +22,8 @@
 #include "model.h"
 
 #include "preprocess.h"
+#include "trim.h"
+#include "vfr.h"
 
 /*****
  * a string s is stored in the speaker model file
@@ -73,6 +75,7 @@ void resetModel(Model *model)
 
     free(tmp_item->label);
     free(tmp_item->command);
+    free(tmp_item->group);
 
     /***** iterate over the list of sample utterances: */
 
@@ -87,6 +90,8 @@ void resetModel(Model *model)
       for (i = 0; i < tmp_sample->length; i++)
 				free(tmp_sample->data[i]);
       free(tmp_sample->data);
+      free(tmp_sample->weight);
+      free(tmp_sample->time);
       if (tmp_sample->has_wav)
         free(tmp_sample->wav_data);
 
@@ -138,6 +143,9 @@ int loadModel(Model *model, char *file_name, int load_wav)
   char tmp_string[1000];
   char tmp_string2[1000];
   int tmp_int;
+  int front_end[5];
+  int has_groups = 0;
+  int has_thresholds = 0;
 
   ModelItem *last_item = NULL;
 
@@ -163,8 +171,58 @@ int loadModel(Model *model, char *file_name, int load_wav)
 
   fgetstring(tmp_string, fp);
   sscanf(tmp_string, "KVoiceControl Speakermodel V%s\n", tmp_string2);
-  if (strcmp(tmp_string2, "1.0") != 0)
+
+  /*****
+   * V1.1 files go on with the front end profile they have been built with
+   * (sample rate, frame size, frame distance in samples, number of bands,
+   * filter bank), V1.0 files all come from the classic 16 kHz front end.
+   * V1.2 files add the group of each reference, V1.3 files the learned
+   * score threshold of each sample utterance
+   *****/
+  if (strcmp(tmp_string2, "1.3") == 0)
+  {
+    fread(front_end, sizeof(int), 5, fp);
+    has_groups = 1;
+    has_thresholds = 1;
+  }
+  else if (strcmp(tmp_string2, "1.2") == 0)
+  {
+    fread(front_end, sizeof(int), 5, fp);
+    has_groups = 1;
+  }
+  else if (strcmp(tmp_string2, "1.1") == 0)
+    fread(front_end, sizeof(int), 5, fp);
+  else if (strcmp(tmp_string2, "1.0") == 0)
+  {
+    front_end[0] = 16000;
+    front_end[1] = 256;
+    front_end[2] = 160;
+    front_end[3] = 16;
+    front_end[4] = FB_classic;
+  }
+  else
+  {
+    fclose(fp);
+    return 0;
+  }
+
+  /*****
+   * feature vectors of a different profile can't be compared to
+   * those of this one: refuse the model
+   *****/
+  if (front_end[0] != RATE || front_end[1] != FFT_SIZE ||
+      front_end[2] != OFFSET/2 || front_end[3] != FEAT_VEC_SIZE)
+  {
+    fprintf(stderr, "Speaker model %s was built for %d Hz audio and %d point frames (%d bands),\n"
+	    "this program uses %d Hz and %d points (%d bands): build the model again!\n",
+	    tmp_file_name, front_end[0], front_end[1], front_end[3], RATE, FFT_SIZE, FEAT_VEC_SIZE);
+    fclose(fp);
     return 0;
+  }
+
+  /***** preprocess everything from now on the way the model has been */
+
+  filter_bank = front_end[4];
 
   /*****
    * read total number of sample utterances
@@ -199,6 +257,17 @@ int loadModel(Model *model, char *file_name, int load_wav)
     new_item->command = (char *)malloc(tmp_int+1);
     fgets(new_item->command, tmp_int+1, fp);
 
+    /***** read reference's group, older models have none */
+
+    if (has_groups)
+    {
+      fread(&tmp_int, sizeof(int), 1, fp);
+      new_item->group = (char *)malloc(tmp_int+1);
+      fgets(new_item->group, tmp_int+1, fp);
+    }
+    else
+      new_item->group = strdup("");
+
     /***** read number of samples */
 
     fread(&(new_item->number_of_samples), sizeof(int), 1, fp);
@@ -211,6 +280,7 @@ int loadModel(Model *model, char *file_name, int load_wav)
 
       ModelItemSample *new_sample = (ModelItemSample *) malloc(sizeof(ModelItemSample));
 			new_sample->next = NULL;
+			new_sample->inContext = 1;
       model->direct[direct_pos]          = new_sample;
       model->direct_map2ref[direct_pos]  = i;
       direct_pos++;
@@ -237,6 +307,12 @@ int loadModel(Model *model, char *file_name, int load_wav)
 				fread(new_sample->data[k], sizeof(float), FEAT_VEC_SIZE, fp);
       }
 
+      /***** read the learned score threshold, older models have none */
+
+      new_sample->threshold = 0;
+      if (has_thresholds)
+				fread(&new_sample->threshold, sizeof(float), 1, fp);
+
       /***** load wav data if present (and if requested!) */
 
       fread(&new_sample->has_wav, sizeof(int), 1, fp);
@@ -250,9 +326,21 @@ int loadModel(Model *model, char *file_name, int load_wav)
 				{
 	  			new_sample->wav_length = 0;
 	  			free(new_sample->wav_data);
+	  			new_sample->wav_data = NULL;
+	  			new_sample->has_wav  = 0;
 				}
       }
 
+      /***** every feature vector stands for one frame, until the model is compressed */
+
+      new_sample->weight = (float*)malloc(sizeof(float) * new_sample->length);
+      new_sample->time   = (float*)malloc(sizeof(float) * new_sample->length);
+      for (k = 0; k < new_sample->length; k++)
+      {
+				new_sample->weight[k] = 1;
+				new_sample->time[k]   = k + 1;
+      }
+
       /***** allocate three rows of DTW matrix */
 
       for (k = 0; k < 3; k++)
@@ -299,6 +387,7 @@ int saveModel(Model *model, char *file_name)
   ModelItemSample *tmp_sample;
   char *tmp_string;
   int tmp_int;
+  int front_end[5];
   int i;
 
   char tmp_file_name[1000];
@@ -316,11 +405,20 @@ int saveModel(Model *model, char *file_name)
 
   /***** write "file header" */
 
-  tmp_string = "KVoiceControl Speakermodel V1.0";
+  tmp_string = "KVoiceControl Speakermodel V1.3";
   tmp_int = (int)strlen(tmp_string);
   fwrite(&tmp_int, sizeof(int), 1, f);
   fputs(tmp_string, f);
 
+  /***** write front end profile (see loadModel()) */
+
+  front_end[0] = RATE;
+  front_end[1] = FFT_SIZE;
+  front_end[2] = OFFSET/2;
+  front_end[3] = FEAT_VEC_SIZE;
+  front_end[4] = filter_bank;
+  fwrite(front_end, sizeof(int), 5, f);
+
   /***** write total number of sample utterances */
 
   tmp_int = 0;
@@ -347,6 +445,12 @@ int saveModel(Model *model, char *file_name)
     fwrite(&tmp_int, sizeof(int), 1, f);
     fputs(tmp_item->command, f);
 
+    /***** write reference's group */
+
+    tmp_int = (int)strlen(tmp_item->group);
+    fwrite(&tmp_int, sizeof(int), 1, f);
+    fputs(tmp_item->group, f);
+
     /***** write number of samples */
 
     tmp_int = (int)tmp_item->number_of_samples;
@@ -377,6 +481,8 @@ int saveModel(Model *model, char *file_name)
 	fwrite(tmp_sample->data[i], sizeof(float), VECSIZE, f);
       }
 
+      fwrite(&tmp_sample->threshold, sizeof(float), 1, f); /***** learned score threshold */
+
       fwrite(&tmp_sample->has_wav, sizeof(int), 1, f); /***** 'wav present' flag */
 
       if (tmp_sample->has_wav) /***** save wav if it is present */
@@ -494,6 +600,8 @@ void deleteModelItemSample(ModelItem *item, int index)
   for (i = 0 ; i < tmp_sample->length; i++)
     free (tmp_sample->data[i]);
   free(tmp_sample->data);
+  free(tmp_sample->weight);
+  free(tmp_sample->time);
 
   free (tmp_sample->id);
   if (tmp_sample->has_wav)
@@ -503,19 +611,147 @@ void deleteModelItemSample(ModelItem *item, int index)
   item->number_of_samples--;
 }
 
+/*****
+ * tell whether 'group' is one of the comma separated 'groups'
+ *****/
+
+static int isInGroups(char *group, char *groups)
+{
+  int length = strlen(group);
+  char *s = groups;
+
+  while (*s == ' ')
+    s++;
+  while (s != NULL && *s != '\0')
+  {
+    if (strncmp(s, group, length) == 0 &&
+	(s[length] == ',' || s[length] == ' ' || s[length] == '\0'))
+      return 1;
+    s = strchr(s, ',');
+    if (s != NULL)
+      while (*++s == ' ')
+        ;
+  }
+
+  return 0;
+}
+
+/********************************************************************************
+ * switch the context of the speaker model to the comma separated list
+ * of 'groups' ("" for all of them, see model.h), plus the references
+ * without a group if 'ungrouped' is set: the sample utterances of the
+ * other references are left out of the recognition runs from now on.
+ * returns the number of sample utterances left in
+ ********************************************************************************/
+
+int setModelContext(Model *model, char *groups, int ungrouped)
+{
+  ModelItem *tmp_item;
+  ModelItemSample *tmp_sample;
+  int in_context, count = 0;
+
+  for (tmp_item = model->first; tmp_item != NULL; tmp_item = tmp_item->next)
+  {
+    if (tmp_item->group[0] == '\0')
+      in_context = ungrouped;
+    else
+      in_context = groups[0] == '\0' || isInGroups(tmp_item->group, groups);
+
+    for (tmp_sample = tmp_item->first; tmp_sample != NULL; tmp_sample = tmp_sample->next)
+    {
+      tmp_sample->inContext = in_context;
+      count += in_context;
+    }
+  }
+
+  return count;
+}
+
 /********************************************************************************
- * activate all samples in a speaker model for recognition
+ * activate all samples in the current context of a speaker model for recognition
  ********************************************************************************/
 
 void activateAllSamples(Model *model)
 {
-  int i;
+  int i, count = 0;
 
   for (i = 0; i < model->total_number_of_sample_utterances; i++)
   {
-    model->direct[i]->isActive = 1;
+    model->direct[i]->isActive = model->direct[i]->inContext;
+    count += model->direct[i]->inContext;
   }
-  model->number_of_active_sample_utterances = model->total_number_of_sample_utterances;
+  model->number_of_active_sample_utterances = count;
+}
+
+/********************************************************************************
+ * remove the silence before and after all sample utterances, the same
+ * way as it is removed from the test utterances (see trim.h). Samples
+ * that would get shorter than SAMPLE_MIN_LENGTH are left as they are.
+ * returns the number of feature vectors left in the model
+ ********************************************************************************/
+
+int trimModel(Model *model, int guard_ms, float snr)
+{
+  ModelItemSample *sample;
+  int i, left = 0;
+
+  for (i = 0; i < model->total_number_of_sample_utterances; i++)
+  {
+    sample = model->direct[i];
+
+    /***** the weights and times of the first vectors stay valid */
+
+    sample->length = trimUtterance(guard_ms, snr, sample->data, sample->length,
+				   SAMPLE_MIN_LENGTH);
+    left += sample->length;
+  }
+
+  return left;
+}
+
+/********************************************************************************
+ * merge runs of similar feature vectors in all sample utterances,
+ * the same way as the test utterances are merged (see vfr.h). Samples
+ * that would get shorter than SAMPLE_MIN_LENGTH are left as they are.
+ * returns the number of feature vectors left in the model
+ ********************************************************************************/
+
+int compressModel(Model *model, float threshold)
+{
+  ModelItemSample *sample;
+  int i, left = 0;
+
+  for (i = 0; i < model->total_number_of_sample_utterances; i++)
+  {
+    sample = model->direct[i];
+
+    /***** the DTW matrix rows keep their size, they are long enough */
+
+    sample->length = vfrCompress(threshold, sample->data, sample->length,
+				 sample->weight, sample->time, SAMPLE_MIN_LENGTH);
+    left += sample->length;
+  }
+
+  return left;
+}
+
+/********************************************************************************
+ * find a sample utterance shorter than SAMPLE_MIN_LENGTH, which can't be
+ * aligned. returns its reference ('idx' is set to its index there), or
+ * NULL if all samples are long enough
+ ********************************************************************************/
+
+ModelItem *findShortSample(Model *model, int *idx)
+{
+  ModelItem *tmp_item;
+  ModelItemSample *tmp_sample;
+
+  for (tmp_item = model->first; tmp_item != NULL; tmp_item = tmp_item->next)
+    for (tmp_sample = tmp_item->first, *idx = 0; tmp_sample != NULL; tmp_sample = tmp_sample->next, (*idx)++)
+      if (tmp_sample->length < SAMPLE_MIN_LENGTH)
+	return tmp_item;
+
+  return NULL;
 }
 
 /********************************************************************************
@@ -555,6 +791,7 @@ void appendEmptyModelItem(Model *model, char *label, char *command)
   strcpy(new_item->label, label);
   new_item->command = (char *)malloc(strlen(command)+1);
   strcpy(new_item->command, command);
+  new_item->group = strdup("");
   new_item->number_of_samples = 0;
   new_item->first             = NULL;
   new_item->next              = NULL;
@@ -596,6 +833,7 @@ void deleteModelItem(Model *model, int index)
 
   free (tmp_item->label);
   free (tmp_item->command);
+  free (tmp_item->group);
   free (tmp_item);
 
   model->number_of_items--; /***** decrease number of items in model */
@@ -23,11 +23,22 @@
 /* # include<stdlib.h> */
 /* # include<stdio.h>  */
 
+/********************************************************************************
+ * fewest feature vectors a sample utterance needs: the DTW reads the first
+ * sloppy_corner + 1 rows and the last sloppy_corner ones (see cvoicecontrol.h)
+ ********************************************************************************/
+
+#define SAMPLE_MIN_LENGTH 5
+
 /********************************************************************************
  * data structure for a sample utterance
  *
  * data    list of feature vectors, each of size FEAT_VEC_SIZE
  * length  number of feature vectors in 'data'
+ * weight  number of frames each feature vector stands for (see vfr.h)
+ * time    sum of the weights up to and including each feature vector
+ * threshold  score threshold learned for this utterance (0: none, the global
+ *         score_threshold applies, see model_thresholds.c)
  * id      'name' of this utterance, usually made up of date and time of donation
  * next    pointer to next sample utterance of the same reference
  * matrix  represents a window of the DTW matrix (used for recognition)
@@ -38,6 +49,9 @@ struct _ModelItemSample
 {
   float **data;
   int     length;
+  float  *weight;
+  float  *time;
+  float   threshold;
   char   *id;
 
   /***** 'wav present' flag plus data structure to store wav */
@@ -59,6 +73,10 @@ struct _ModelItemSample
    ********************************************************************************/
 
   int isActive;
+
+  /***** whether the reference of this utterance is in the current context */
+
+  int inContext;
 };
 typedef struct _ModelItemSample ModelItemSample;
 
@@ -71,6 +89,7 @@ typedef struct _ModelItemSample ModelItemSample;
  * number_of_samples   number of sample utterances in the list
  * label               transcription of 'what is said'
  * command             this command is executed in case this reference is recognized
+ * group               context the reference belongs to, "" for all contexts
  *
  * first               pointer to the first sample utterance in the list
  *
@@ -82,6 +101,7 @@ struct _ModelItem
   int   number_of_samples;
   char *label;
   char *command;
+  char *group;
 
   ModelItemSample *first;
 
@@ -120,12 +140,29 @@ ModelItemSample *getModelItemSample(ModelItem *item, int idx);
 void appendModelItemSample(ModelItem *item, ModelItemSample *new_sample);
 void deleteModelItemSample(ModelItem *item, int index);
 
+int  setModelContext(Model *model, char *groups, int ungrouped);
 void activateAllSamples();
+int  trimModel(Model *model, int guard_ms, float snr);
+int  compressModel(Model *model, float threshold);
+ModelItem *findShortSample(Model *model, int *idx);
 
 void appendModelItem(Model *model, ModelItem *new_item);
 void appendEmptyModelItem(Model *model, char *label, char *command);
 void deleteModelItem(Model *model, int index);
 
+/********************************************************************************
+ * contexts: only the references in one of the active groups (a comma
+ * separated list, "" for all groups) and those without a group take part
+ * in a recognition run. The groups active at start are given by the
+ * configuration ('start_context'), a reference with the special command
+ * "cvoicecontrol_context <groups>" switches them.
+ ********************************************************************************/
+
+#define CONTEXT_SIZE 80
+#define CONTEXT_COMMAND "cvoicecontrol_context"
+
+extern char start_context[CONTEXT_SIZE];
+
 #ifdef MAIN_C
 char *model_file_extension = ".cvc";
 #else
@@ -216,6 +216,9 @@ ModelItemSample *recordSample()
   sprintf( new_sample->id, "[%s]", tmp_string );
 
   new_sample->next   = NULL; /***** next sample pointer is NULL */
+  new_sample->weight = NULL; /***** weights are only needed for recognition */
+  new_sample->time   = NULL;
+  new_sample->threshold = 0; /***** no score threshold learned yet */
   {
     int i;
     for (i = 0; i < 3; i++)
@@ -266,7 +269,7 @@ void editModelItem(ModelItem *model_item)
 
     mvwaddseparator(itemscr, height-4, width);
     mvwaddstr(itemscr, height-3, 2, "r = record sample, d = delete sample, enter = play sample");
-    mvwaddstr(itemscr, height-2, 2, "b = back to model menu, l = edit label, c = edit command");
+    mvwaddstr(itemscr, height-2, 2, "b = back, l = edit label, c = edit command, g = edit group");
 
     /***** display information about current speaker item */
 
@@ -274,6 +277,8 @@ void editModelItem(ModelItem *model_item)
     mvwaddnstr(itemscr, 4, 12, model_item->label, input_field_width);
     mvwaddstr(itemscr, 5, 2, "Command :");
     mvwaddnstr(itemscr, 5, 12, model_item->command, input_field_width);
+    mvwaddstr(itemscr, 6, 2, "Group   :");
+    mvwaddnstr(itemscr, 6, 12, model_item->group, input_field_width);
 
     mvwaddstr(itemscr, 7, 2, "Number of samples:");
     mvwaddint(itemscr, 7, 21, model_item->number_of_samples);
@@ -495,6 +500,20 @@ void editModelItem(ModelItem *model_item)
 	  modified = 1;
       }
       break;
+    case 'g': /***** edit group */
+      {
+	/*****
+	 * use wstringInput to edit the group (context) of the current utterance
+	 * if the group has changed, switch 'modified' to 1
+	 *****/
+	char tmp_string[1000];
+	strcpy(tmp_string, model_item->group);
+	free(model_item->group);
+	model_item->group = wstringInput(itemscr, 6, 12, 255, input_field_width, tmp_string);
+	if (strcmp(tmp_string, model_item->group) != 0)
+	  modified = 1;
+      }
+      break;
     case 'd':
       /*****
        * delete currently selected sample utterance from model item
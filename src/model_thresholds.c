@@ -0,0 +1,373 @@
+/***************************************************************************
+                          model_thresholds.c  -  learns a score threshold
+                                                 for each sample utterance
+                                                 of a model
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define MAIN_C
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+
+#include "cvoicecontrol.h"
+#include "model.h"
+#include "dtw.h"
+#include "trim.h"
+#include "vfr.h"
+
+#include "../config.h"
+
+/********************************************************************************
+ * The recognizer drops a sample utterance as soon as the minimum distance
+ * in a DTW column exceeds the score threshold, and it accepts the final
+ * score only below it. So the lowest threshold that lets sample 'ref'
+ * recognize utterance 'test' is the highest of these column minima and
+ * the final score: the peak of the alignment.
+ *
+ * Each sample is aligned with the other samples of its reference, as if
+ * they had been spoken to the recognizer. Its threshold is the largest of
+ * these peaks times a safety factor. Samples that are tight and
+ * consistent get a low threshold and are dropped early when something
+ * else is said.
+ ********************************************************************************/
+
+#define FACTOR 2.0
+
+/*
+ * align sample 'test' with sample 'ref' the way the recognizer does,
+ * 'vectors' has room for the merged feature vectors of 'test'.
+ * 'column_min' receives the minimum distance of each DTW column.
+ * returns the final score (float_max if the columns left the adjustment
+ * window first, then fewer columns have been entered)
+ */
+
+float align( ModelItemSample *ref, ModelItemSample *test, float *vectors, float *column_min, int *columns )
+{
+    float *frame;
+    int pos;
+
+    for( pos = 0; pos < test->length; pos++ )
+    {
+        frame = vectors + pos * VFR_VEC_SIZE;
+        memcpy( frame, test->data[pos], sizeof( float ) * FEAT_VEC_SIZE );
+        frame[VFR_WEIGHT] = test->weight[pos];
+        frame[VFR_TIME] = test->time[pos];
+    }
+
+    for( pos = 0; pos < test->length; pos++ )
+    {
+        if( pos - adjust_window_width > ref->length ) break;
+
+        frame = vectors + pos * VFR_VEC_SIZE;
+        column_min[pos] = dtwColumn( ref, pos, frame, pos > 0 ? frame - VFR_VEC_SIZE : NULL );
+    }
+    *columns = pos;
+
+    if( pos < test->length || pos <= 2 ) return float_max;
+
+    return dtwScore( ref, pos - 1, vectors[( pos - 1 ) * VFR_VEC_SIZE + VFR_TIME] );
+}
+
+/* peak of an alignment (see above) */
+
+float peak( float *column_min, int columns, float score )
+{
+    int pos;
+
+    for( pos = 2; pos < columns; pos++ )
+        if( column_min[pos] > score ) score = column_min[pos];
+
+    return score;
+}
+
+/* number of DTW columns the recognizer calculates before it drops the sample at 'threshold' */
+
+int columnsUntil( float *column_min, int columns, float threshold )
+{
+    int pos;
+
+    for( pos = 2; pos < columns; pos++ )
+        if( column_min[pos] > threshold ) return pos + 1;
+
+    return columns;
+}
+
+/*
+ * threshold of sample 's' of a reference with 'n' samples, 'peaks'
+ * holds the peaks of all pairs (test sample by row). The peaks of test
+ * sample 'left_out' are not used (-1: all are), nor those above the
+ * global threshold, which is not reached anyway. 0 if there are none.
+ */
+
+float threshold( float *peaks, int n, int s, int left_out, float factor, float global )
+{
+    float result = 0;
+    int u;
+
+    for( u = 0; u < n; u++ )
+        if( u != s && u != left_out && peaks[u * n + s] <= global && peaks[u * n + s] > result )
+            result = peaks[u * n + s];
+
+    result *= factor;
+
+    return result > 0 && result < global ? result : 0;
+}
+
+/* the threshold the recognizer uses for a sample (see sampleThreshold() in cvoicecontrol.c) */
+
+float effective( float learned, float global )
+{
+    return learned > 0 && learned < global ? learned : global;
+}
+
+void usage( const char *prog )
+{
+    printf( "Version: " VERSION "\n" );
+    printf( "Usage: %s [options] <speakermodel.cvc>\n", prog );
+    printf( "Learns a score threshold for each sample utterance of a speaker model from the\n" );
+    printf( "distances to the other samples of its reference, and reports how many samples\n" );
+    printf( "would still be recognized if left out of the learning (leave-one-out).\n" );
+    printf( "Options:\n" );
+    printf( "\t-f, --factor <f>        Safety factor on the largest distance (default %g)\n", FACTOR );
+    printf( "\t-r, --per-reference     One threshold for all samples of a reference\n" );
+    printf( "\t-s, --score <t>         Global 'Score Threshold' of the configuration (default 18)\n" );
+    printf( "\t-t, --trim <ms>         'Trim Silence' of the configuration (default off)\n" );
+    printf( "\t-m, --merge <t>         'Frame Merging' of the configuration (default off)\n" );
+    printf( "\t-o, --output <file>     Save the model with the thresholds (otherwise only report)\n" );
+    printf( "\t-V, --version           Print version and exit\n" );
+    printf( "\t-h, --help              Show this help\n" );
+    printf( "\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+    Model model, work;
+    ModelItem *item;
+    ModelItemSample *ref, *test;
+    char *output = NULL;
+    float factor = FACTOR, global = 18;
+    int per_reference = 0;
+    float *learned, *peaks, *vectors, *column_min, score, t;
+    int *first, *count;
+    int longest = 0, columns, i, j, k, r, n;
+    int recalled_global = 0, recalled_learned = 0, tested = 0;
+    double columns_global = 0, columns_learned = 0;
+
+    struct option long_options[] = {
+        { "factor", required_argument, 0, 'f' },
+        { "per-reference", no_argument, 0, 'r' },
+        { "score", required_argument, 0, 's' },
+        { "trim", required_argument, 0, 't' },
+        { "merge", required_argument, 0, 'm' },
+        { "output", required_argument, 0, 'o' },
+        { "version", no_argument, 0, 'V' },
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    int ret;
+
+    while( ( ret = getopt_long( argc, argv, "f:rs:t:m:o:Vh", long_options, NULL ) ) != -1 )
+    {
+        switch ( ret )
+        {
+            case 'f':
+                factor = atof( optarg );
+                break;
+            case 'r':
+                per_reference = 1;
+                break;
+            case 's':
+                global = atof( optarg );
+                break;
+            case 't':
+                trim_guard = atoi( optarg );
+                break;
+            case 'm':
+                vfr_threshold = atof( optarg );
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'V':
+                printf( PACKAGE " version " VERSION "\n" );
+                return 0;
+            case 'h':
+            default:
+                usage( argv[0] );
+                return 0;
+        }
+    }
+
+    if( optind >= argc )
+    {
+        fprintf( stderr, "\nPlease specify speakermodel.cvc file!\n\n" );
+        usage( argv[0] );
+        return -1;
+    }
+    if( factor < 1 || global <= 0 || trim_guard > TRIM_HOLD_MAX * 10 || vfr_threshold < 0 )
+    {
+        fprintf( stderr, "Invalid factor (at least 1), score threshold, trim guard or frame merging threshold!\n" );
+        return -1;
+    }
+
+    initDtw(  );
+
+    /*
+     * the samples are aligned the way the recognizer sees them ('work'),
+     * the model is saved as it has been loaded, with the wave data
+     */
+    initModel( &model );
+    initModel( &work );
+    if( loadModel( &model, argv[optind], 1 ) == 0 || loadModel( &work, argv[optind], 0 ) == 0 )
+    {
+        fprintf( stderr, "Failed to load speaker model: %s !\n", argv[optind] );
+        return -1;
+    }
+
+    if( trim_guard >= 0 ) trimModel( &work, trim_guard, trim_snr );
+    if( vfr_threshold > 0 ) compressModel( &work, vfr_threshold );
+
+    if( ( item = findShortSample( &work, &i ) ) != NULL )
+    {
+        fprintf( stderr, "Sample %d of '%s' is too short (fewer than %d feature vectors)!\n",
+                 i, item->label, SAMPLE_MIN_LENGTH );
+        return -1;
+    }
+
+    for( i = 0; i < work.total_number_of_sample_utterances; i++ )
+        if( work.direct[i]->length > longest ) longest = work.direct[i]->length;
+
+    vectors = ( float * )malloc( sizeof( float ) * VFR_VEC_SIZE * longest );
+    column_min = ( float * )malloc( sizeof( float ) * longest );
+    learned = ( float * )malloc( sizeof( float ) * work.total_number_of_sample_utterances );
+    first = ( int * )malloc( sizeof( int ) * work.number_of_items );
+    count = ( int * )malloc( sizeof( int ) * work.number_of_items );
+
+    /* sample utterances of each reference in 'direct' */
+
+    for( item = work.first, r = 0, n = 0; item != NULL; item = item->next, r++ )
+    {
+        first[r] = n;
+        count[r] = item->number_of_samples;
+        n += item->number_of_samples;
+    }
+
+    /* learn the thresholds, reference by reference */
+
+    for( item = work.first, r = 0; item != NULL; item = item->next, r++ )
+    {
+        n = count[r];
+        peaks = ( float * )malloc( sizeof( float ) * n * n );
+
+        for( i = 0; i < n; i++ )
+            for( j = 0; j < n; j++ )
+            {
+                if( i == j ) continue;
+
+                test = work.direct[first[r] + i];
+                ref = work.direct[first[r] + j];
+                score = align( ref, test, vectors, column_min, &columns );
+                peaks[i * n + j] = score < float_max ? peak( column_min, columns, score ) : float_max;
+            }
+
+        printf( "%s:\n", item->label );
+        for( j = 0, t = 0; j < n; j++ )
+        {
+            learned[first[r] + j] = threshold( peaks, n, j, -1, factor, global );
+            if( learned[first[r] + j] > t ) t = learned[first[r] + j];
+        }
+        for( j = 0; j < n; j++ )
+        {
+            if( per_reference ) learned[first[r] + j] = t;
+            if( learned[first[r] + j] > 0 )
+                printf( "  sample %d: threshold %.3f\n", j, learned[first[r] + j] );
+            else
+                printf( "  sample %d: no threshold (global %.3f)\n", j, global );
+        }
+
+        /*
+         * held out: is sample i still recognized by one of the others
+         * with the thresholds learned without it?
+         */
+        for( i = 0; i < n && n > 1; i++ )
+        {
+            int hit_global = 0, hit_learned = 0;
+
+            for( j = 0, t = 0; per_reference && j < n; j++ )
+                if( j != i && threshold( peaks, n, j, i, factor, global ) > t )
+                    t = threshold( peaks, n, j, i, factor, global );
+
+            for( j = 0; j < n; j++ )
+            {
+                if( j == i || peaks[i * n + j] >= float_max ) continue;
+
+                if( peaks[i * n + j] <= global ) hit_global = 1;
+                if( peaks[i * n + j] <= effective( per_reference ? t : threshold( peaks, n, j, i, factor, global ),
+                                                   global ) )
+                    hit_learned = 1;
+            }
+
+            tested++;
+            recalled_global += hit_global;
+            recalled_learned += hit_learned;
+        }
+
+        free( peaks );
+    }
+
+    /* work done on utterances of other references: how early are the samples dropped? */
+
+    for( r = 0; r < work.number_of_items; r++ )
+        for( i = first[r]; i < first[r] + count[r]; i++ )
+            for( k = 0; k < work.total_number_of_sample_utterances; k++ )
+            {
+                if( k >= first[r] && k < first[r] + count[r] ) continue;
+
+                align( work.direct[k], work.direct[i], vectors, column_min, &columns );
+                columns_global += columnsUntil( column_min, columns, global );
+                columns_learned += columnsUntil( column_min, columns, effective( learned[k], global ) );
+            }
+
+    printf( "\nheld out samples recognized by their reference: %d of %d with the global threshold, "
+            "%d of %d with the learned ones\n", recalled_global, tested, recalled_learned, tested );
+    printf( "DTW columns of the samples of the other references: %.0f -> %.0f (%.1f%% less)\n",
+            columns_global, columns_learned,
+            columns_global > 0 ? 100.0 * ( columns_global - columns_learned ) / columns_global : 0 );
+
+    if( output != NULL )
+    {
+        for( i = 0; i < model.total_number_of_sample_utterances; i++ )
+            model.direct[i]->threshold = learned[i];
+
+        if( saveModel( &model, output ) == 0 )
+        {
+            fprintf( stderr, "Failed to save speaker model: %s !\n", output );
+            return -1;
+        }
+    }
+
+    free( vectors );
+    free( column_min );
+    free( learned );
+    free( first );
+    free( count );
+    resetModel( &model );
+    resetModel( &work );
+
+    return 0;
+}
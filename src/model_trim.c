@@ -0,0 +1,169 @@
+/***************************************************************************
+                          model_trim.c  -  removes the silence around the
+                                           sample utterances of a model
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define MAIN_C
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+
+#include "model.h"
+#include "trim.h"
+
+#include "../config.h"
+
+/********************************************************************************
+ * DTW matrix cells needed to recognize each sample utterance of the model
+ * against all the others (the adjustment window is not taken into account)
+ ********************************************************************************/
+
+double dtwCells( Model *model, int *length )
+{
+    double cells = 0, total = 0;
+    int i;
+
+    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
+        total += length[i];
+
+    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
+        cells += ( double )length[i] * ( total - length[i] );
+
+    return cells;
+}
+
+void usage( const char *prog )
+{
+    printf( "Version: " VERSION "\n" );
+    printf( "Usage: %s [options] <speakermodel.cvc>\n", prog );
+    printf( "Removes the silence before and after the sample utterances of a speaker model\n" );
+    printf( "and reports how much smaller the DTW matrices get.\n" );
+    printf( "Options:\n" );
+    printf( "\t-g, --guard <ms>     Silence kept next to the speech (default %d ms)\n", TRIM_GUARD_MS );
+    printf( "\t-s, --snr <dB>       Distance of speech from the noise floor (default %g dB)\n", trim_snr );
+    printf( "\t-o, --output <file>  Save the trimmed model (otherwise only report)\n" );
+    printf( "\t-V, --version        Print version and exit\n" );
+    printf( "\t-h, --help           Show this help\n" );
+    printf( "\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+    Model model;
+    ModelItem *item;
+    ModelItemSample *sample;
+    char *output = NULL;
+    int guard_ms = TRIM_GUARD_MS;
+    int *length;
+    int frames = 0, left = 0, i, j, n;
+    double before, after;
+
+    struct option long_options[] = {
+        { "guard", required_argument, 0, 'g' },
+        { "snr", required_argument, 0, 's' },
+        { "output", required_argument, 0, 'o' },
+        { "version", no_argument, 0, 'V' },
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    int ret;
+
+    while( ( ret = getopt_long( argc, argv, "g:s:o:Vh", long_options, NULL ) ) != -1 )
+    {
+        switch ( ret )
+        {
+            case 'g':
+                guard_ms = atoi( optarg );
+                break;
+            case 's':
+                trim_snr = atof( optarg );
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'V':
+                printf( PACKAGE " version " VERSION "\n" );
+                return 0;
+            case 'h':
+            default:
+                usage( argv[0] );
+                return 0;
+        }
+    }
+
+    if( optind >= argc )
+    {
+        fprintf( stderr, "\nPlease specify speakermodel.cvc file!\n\n" );
+        usage( argv[0] );
+        return -1;
+    }
+    if( guard_ms < 0 || guard_ms > TRIM_HOLD_MAX * 10 || trim_snr <= 0 )
+    {
+        fprintf( stderr, "Invalid guard or SNR (the guard is at most %d ms)!\n", TRIM_HOLD_MAX * 10 );
+        return -1;
+    }
+
+    initModel( &model );
+
+    /* keep the wave data, it is saved with the trimmed model */
+
+    if( loadModel( &model, argv[optind], 1 ) == 0 )
+    {
+        fprintf( stderr, "Failed to load speaker model: %s !\n", argv[optind] );
+        return -1;
+    }
+
+    length = ( int * )malloc( sizeof( int ) * model.total_number_of_sample_utterances );
+    for( i = 0; i < model.total_number_of_sample_utterances; i++ )
+        length[i] = model.direct[i]->length;
+    before = dtwCells( &model, length );
+
+    /* trim sample by sample, to report each of them */
+
+    n = 0;
+    for( item = model.first; item != NULL; item = item->next )
+    {
+        printf( "%s:\n", item->label );
+        for( sample = item->first, j = 0; sample != NULL; sample = sample->next, j++, n++ )
+        {
+            frames += sample->length;
+            sample->length = trimUtterance( guard_ms, trim_snr, sample->data, sample->length, SAMPLE_MIN_LENGTH );
+            left += sample->length;
+
+            printf( "  sample %d: %d -> %d frames\n", j, length[n], sample->length );
+            length[n] = sample->length;
+        }
+    }
+    after = dtwCells( &model, length );
+
+    printf( "\n%d -> %d frames (%.1f%% less)\n", frames, left,
+            frames > 0 ? 100.0 * ( frames - left ) / frames : 0 );
+    printf( "DTW matrix cells, each sample against all others: %.0f -> %.0f (%.1f%% less)\n",
+            before, after, before > 0 ? 100.0 * ( before - after ) / before : 0 );
+
+    if( output != NULL && saveModel( &model, output ) == 0 )
+    {
+        fprintf( stderr, "Failed to save speaker model: %s !\n", output );
+        return -1;
+    }
+
+    free( length );
+    resetModel( &model );
+
+    return 0;
+}
@@ -17,139 +17,341 @@
  ***************************************************************************/
 
 #include<math.h>
+#include<stdlib.h>
+#include<string.h>
 
 #include "realfftf.h"
 #include "preprocess.h"
 
 /*****
-  used for reduction of short-time spectrum to mel scale coefficients
+  band edges of the classic filter bank (power spectrum bins of 62.5 Hz,
+  i.e. 16 kHz audio and 256 point frames, up to 7250 Hz)
   *****/
-int   filter_banks[17];
+static const int classic_banks[FEAT_VEC_SIZE+1] =
+  { 0, 2, 6, 10, 14, 18, 22, 26, 30, 35, 41, 48, 57, 68, 81, 97, 116 };
 
 /*****
-  contains the power spectrum
+  filter bank new speaker models are built with
   *****/
-float power_spec[POWER_SPEC_SIZE];
-
-/********************************************************************************
- * Hamming window width = 16ms ! (256 Frames)
- * (hamming_size == fft_size)
- *
- * a window function that a frame of audio values is multiplied with.
- * This is done to smoothen the beginning and end of a frame,
- * i.e. to reduce discontinuities at the two ends and as a result
- * to reduce the number of artefacts in the power spectrum
- ********************************************************************************/
-
-float hamming_window[HAMMING_SIZE];
+int filter_bank = DEFAULT_FILTER_BANK;
 
 /*****
   The characteristics of the recording channel
   This is substracted from each feature vector to reduce
   channel effects
   *****/
-int   do_mean_sub;
 float channel_mean[FEAT_VEC_SIZE];
 
-int i,j; /***** counter variables */
+/*****
+  context of defaultPreprocessor()
+  *****/
+static Preprocessor *default_preprocessor = NULL;
 
 /********************************************************************************
- * initialize preprocessing s tuff
+ * band edges of the mel scale filter bank for the current profile:
+ * FEAT_VEC_SIZE bands of equal width on the mel scale from 0 Hz to
+ * 0.45 * RATE (a bit below the Nyquist frequency, where the anti-alias
+ * filter of the sound card sets in), each band at least one bin wide
  ********************************************************************************/
 
-int initPreprocess()
+static void melBanks(int *banks)
 {
-  float tmp;
+  double mel_max = 2595.0*log10(1.0 + 0.45*RATE/700.0);
+  double hz;
   int i;
 
-  /*****
-   * the following is strictly speaking not necessary
-   * as the channel mean will be read from the configuration file later on.
-   *****/
-  for (i = 0; i < VECSIZE; i++)
-    channel_mean[i] = 0;
+  for (i = 0; i <= FEAT_VEC_SIZE; i++)
+  {
+    hz = 700.0*(pow(10.0, mel_max*i/FEAT_VEC_SIZE/2595.0) - 1.0);
+    banks[i] = (int)(hz*FFT_SIZE/RATE + 0.5);
+
+    if (i > 0 && banks[i] <= banks[i-1])
+      banks[i] = banks[i-1] + 1;
+  }
+}
+
+/********************************************************************************
+ * set up a preprocessing context using the given filter bank,
+ * returns NULL on error (or if the filter bank doesn't fit the profile)
+ ********************************************************************************/
+
+Preprocessor *createPreprocessor(int bank)
+{
+  Preprocessor *pp;
+  int   banks[FEAT_VEC_SIZE+1];
+  float tmp;
+  int i, j, k;
+
+  switch (bank)
+  {
+  case FB_classic:
+    if (2*RATE != 125*FFT_SIZE || classic_banks[FEAT_VEC_SIZE] >= POWER_SPEC_SIZE)
+      return NULL;
+    memcpy(banks, classic_banks, sizeof(banks));
+    break;
+  case FB_mel:
+    melBanks(banks);
+    break;
+  default:
+    return NULL;
+  }
+
+  if ((pp = (Preprocessor *)malloc(sizeof(Preprocessor))) == NULL)
+    return NULL;
+
+  pp->filter_bank = bank;
 
   /***** initialize external fft procedure */
 
-  initialize_FFT(FFT_SIZE);
+  if ((pp->fft_plan = createFFTPlan(FFT_SIZE)) == NULL)
+  {
+    free(pp);
+    return NULL;
+  }
 
-  /***** setup hamming window */
+  /********************************************************************************
+   * Hamming window width = 16ms ! (256 Frames)
+   * (hamming_size == fft_size)
+   *
+   * a window function that a frame of audio values is multiplied with.
+   * This is done to smoothen the beginning and end of a frame,
+   * i.e. to reduce discontinuities at the two ends and as a result
+   * to reduce the number of artefacts in the power spectrum
+   ********************************************************************************/
 
   tmp = 2.0*M_PI/(HAMMING_SIZE-1);
   for (i = 0; i < HAMMING_SIZE; i++)
-    hamming_window[i] = 0.54 - 0.46*cos(tmp*i);
-
-  /***** initialize mel scale filter bank */
-
-  filter_banks[0]=0;
-  filter_banks[1]=2;
-  filter_banks[2]=6;
-  filter_banks[3]=10;
-  filter_banks[4]=14;
-  filter_banks[5]=18;
-  filter_banks[6]=22;
-  filter_banks[7]=26;
-  filter_banks[8]=30;
-  filter_banks[9]=35;
-  filter_banks[10]=41;
-  filter_banks[11]=48;
-  filter_banks[12]=57;
-  filter_banks[13]=68;
-  filter_banks[14]=81;
-  filter_banks[15]=97;
-  filter_banks[16]=116;
-
-  do_mean_sub = 1; /***** turn substraction of channel mean vector on! */
-
-  return 1; /***** return ok */
+    pp->hamming_window[i] = 0.54 - 0.46*cos(tmp*i);
+
+  /*****
+    filter bank: the bins at the edges of a band are shared
+    with the neighbouring band and count half, except for the DC bin
+    *****/
+  for (i = 0, k = 0; i < FEAT_VEC_SIZE; i++)
+  {
+    pp->filter_start[i]  = banks[i];
+    pp->filter_length[i] = banks[i+1] - banks[i] + 1;
+    pp->filter_offset[i] = k;
+
+    for (j = banks[i]; j <= banks[i+1]; j++)
+      if (j == banks[i+1] || (j == banks[i] && j != 0))
+        pp->filter_weight[k++] = 0.5;
+      else
+        pp->filter_weight[k++] = 1.0;
+  }
+
+  setChannelMean(pp, NULL);
+
+  return pp;
+}
+
+/********************************************************************************
+ * free a preprocessing context
+ ********************************************************************************/
+
+void destroyPreprocessor(Preprocessor *pp)
+{
+  if (pp == NULL)
+    return;
+
+  destroyFFTPlan(pp->fft_plan);
+  free(pp);
+}
+
+/********************************************************************************
+ * set the vector that is substracted from each feature vector,
+ * NULL turns the substraction off
+ ********************************************************************************/
+
+void setChannelMean(Preprocessor *pp, const float *mean)
+{
+  pp->do_mean_sub = (mean != NULL);
+
+  if (mean != NULL)
+    memcpy(pp->channel_mean, mean, sizeof(pp->channel_mean));
+  else
+    memset(pp->channel_mean, 0, sizeof(pp->channel_mean));
+}
+
+/********************************************************************************
+ * the context shared by everything that preprocesses whole utterances
+ * (see audio.h), created when it is first needed (and set up again if
+ * filter_bank has been changed, i.e. a speaker model has been loaded).
+ * Its channel mean is zero: so far, neither the utterances of a speaker
+ * model nor the recognizer have had the channel mean substracted,
+ * the two of them have to stay compatible.
+ ********************************************************************************/
+
+const Preprocessor *defaultPreprocessor()
+{
+  if (default_preprocessor != NULL && default_preprocessor->filter_bank != filter_bank)
+  {
+    destroyPreprocessor(default_preprocessor);
+    default_preprocessor = NULL;
+  }
+
+  if (default_preprocessor == NULL)
+    default_preprocessor = createPreprocessor(filter_bank);
+
+  return default_preprocessor;
+}
+
+/********************************************************************************
+ * fast approximation of log2(x) for normal, positive x:
+ * exponent plus a polynomial for the mantissa in [1,2)
+ * (absolute error below 2e-5, i.e. far below the resolution
+ * that matters for the feature vectors)
+ ********************************************************************************/
+
+static inline float fastLog2(float x)
+{
+  union { float f; unsigned int i; } v;
+  float e, m;
+
+  v.f = x;
+  e   = (float)(int)((v.i >> 23) & 0xff) - 127;
+  v.i = (v.i & 0x007fffff) | 0x3f800000;
+  m   = v.f - 1.0;
+
+  return e + m*(1.4418799 + m*(-0.708865217 + m*(0.415245559 +
+                m*(-0.193516522 + m*0.0452682917))));
 }
 
 /********************************************************************************
  * preprocess a frame of audio data
  ********************************************************************************/
 
-int preprocessFrame(float *frame, float *result)
+int preprocessFrame(const Preprocessor *pp, const float *frame, float *result)
 {
-  real_FFT(frame); /***** fast fourier transformation of the frame */
+  float spectrum[FFT_SIZE];
+  float power_spec[POWER_SPEC_SIZE];
+  float band[FEAT_VEC_SIZE];
+  int i, j;
+
+  realFFT(pp->fft_plan, frame, spectrum); /***** fast fourier transformation of the frame */
 
-  /***** gather power spectrum from results */
+  /***** power spectrum from results (in normal order) */
 
   for (i = 0 ; i < POWER_SPEC_SIZE ; i++)
-    power_spec[i] = frame[bit_reversed[i]]*frame[bit_reversed[i]]+
-      frame[bit_reversed[i]+1]*frame[bit_reversed[i]+1];
+    power_spec[i] = spectrum[2*i]*spectrum[2*i] + spectrum[2*i+1]*spectrum[2*i+1];
 
   /***** mel scale reduction */
 
   for (i = 0; i < FEAT_VEC_SIZE; i++)
   {
-    int from = (int)filter_banks[i  ];
-    int to   = (int)filter_banks[i+1];
-
-    if (from == 0)
-      result[i] = power_spec[0];
-    else
-      result[i] = power_spec[from]/2.0;
-    result[i] += power_spec[to]/2.0;
-    for (j = from+1; j <= to-1; j++)
-      result[i] += power_spec[j];
-    result[i] = log(result[i] + 1.0)/M_LN2;
-
-    /***** substraction of channel mean */
-
-    if (do_mean_sub)
-      result[i] = result[i] - channel_mean[i];
+    const float *weight = pp->filter_weight + pp->filter_offset[i];
+    const float *power  = power_spec + pp->filter_start[i];
+    float sum = 1.0;
+
+    for (j = 0; j < pp->filter_length[i]; j++)
+      sum += weight[j]*power[j];
+    band[i] = sum;
   }
 
+  /***** logarithm and substraction of channel mean in one pass */
+
+  if (pp->do_mean_sub)
+    for (i = 0; i < FEAT_VEC_SIZE; i++)
+      result[i] = fastLog2(band[i]) - pp->channel_mean[i];
+  else
+    for (i = 0; i < FEAT_VEC_SIZE; i++)
+      result[i] = fastLog2(band[i]);
+
   return 1;
 }
 
 /********************************************************************************
- * wrap up preprocessing component (free memory etc.)
+ * building blocks of preprocessFrames(): each one does one step of
+ * preprocessFrame() for FFT_LANES interleaved spectra (see realfftf.h).
+ * The pointers never overlap, telling the compiler so lets it turn
+ * the lane loops into vector instructions.
+ ********************************************************************************/
+
+static inline void powerLanes(float *restrict power, const float *restrict spectrum)
+{
+  int i, l;
+
+  for (i = 0; i < POWER_SPEC_SIZE; i++)
+    for (l = 0; l < FFT_LANES; l++)
+      power[i*FFT_LANES+l] = spectrum[2*i*FFT_LANES+l]*spectrum[2*i*FFT_LANES+l] +
+        spectrum[(2*i+1)*FFT_LANES+l]*spectrum[(2*i+1)*FFT_LANES+l];
+}
+
+static inline void bandLanes(float *restrict band, const float *restrict power,
+                             const float *restrict weight, int length)
+{
+  int j, l;
+
+  for (l = 0; l < FFT_LANES; l++)
+    band[l] = 1.0;
+
+  for (j = 0; j < length; j++)
+    for (l = 0; l < FFT_LANES; l++)
+      band[l] += weight[j]*power[j*FFT_LANES+l];
+}
+
+/********************************************************************************
+ * preprocess n frames of audio data (stored one after the other) into
+ * n feature vectors: FFT_LANES frames at a time are run through all steps
+ * side by side, the rest is done one frame at a time.
+ * The results are the same as those of preprocessFrame().
  ********************************************************************************/
 
-void endPreprocess()
+int preprocessFrames(const Preprocessor *pp, int n, const float *frames, float *results)
 {
-  /***** cleanup */
+  float padded[FFT_SIZE*FFT_LANES];       /***** last few frames, padded with silence */
+  float spectrum[FFT_SIZE*FFT_LANES];     /***** interleaved spectra */
+  float power[POWER_SPEC_SIZE*FFT_LANES]; /***** interleaved power spectra */
+  float band[FEAT_VEC_SIZE][FFT_LANES];
+  const float *input;
+  int f, i, l, lanes;
+
+  for (f = 0; f < n; f += FFT_LANES)
+  {
+    lanes = (n-f < FFT_LANES) ? n-f : FFT_LANES;
+    input = frames + f*FFT_SIZE;
+
+    /*****
+      a group of a few frames is still faster side by side
+      than one at a time, fewer ones are not
+      *****/
+    if (lanes < FFT_LANES/2)
+    {
+      for (; f < n; f++)
+        preprocessFrame(pp, frames + f*FFT_SIZE, results + f*FEAT_VEC_SIZE);
+      break;
+    }
+    if (lanes < FFT_LANES)
+    {
+      memcpy(padded, input, sizeof(float)*FFT_SIZE*lanes);
+      memset(padded + FFT_SIZE*lanes, 0, sizeof(float)*FFT_SIZE*(FFT_LANES-lanes));
+      input = padded;
+    }
+
+    realFFTLanes(pp->fft_plan, input, spectrum);
+
+    powerLanes(power, spectrum);
+
+    /***** mel scale reduction */
+
+    for (i = 0; i < FEAT_VEC_SIZE; i++)
+      bandLanes(band[i], power + pp->filter_start[i]*FFT_LANES,
+                pp->filter_weight + pp->filter_offset[i], pp->filter_length[i]);
+
+    /***** logarithm and substraction of channel mean */
+
+    for (i = 0; i < FEAT_VEC_SIZE; i++)
+    {
+      const float mean = pp->do_mean_sub ? pp->channel_mean[i] : 0;
+
+      for (l = 0; l < FFT_LANES; l++)
+        band[i][l] = fastLog2(band[i][l]) - mean;
+    }
+
+    for (l = 0; l < lanes; l++)
+      for (i = 0; i < FEAT_VEC_SIZE; i++)
+        results[(f+l)*FEAT_VEC_SIZE+i] = band[i][l];
+  }
 
-  end_FFT();
+  return 1;
 }
@@ -19,6 +19,31 @@
 #ifndef PREPROCESS_H
 #define PREPROCESS_H
 
+#include "realfftf.h"
+
+/********************************************************************************
+ * front end profile, chosen at configure time (--with-rate):
+ *
+ *   RATE = 16000   16 kHz audio, 256 point frames (the default)
+ *   RATE =  8000    8 kHz audio, 128 point frames (narrowband, half the
+ *                  capture and preprocessing cost)
+ *
+ * both of them use 16 ms frames every 10 ms, speaker models record
+ * the profile they have been built with (see model.c)
+ ********************************************************************************/
+
+#ifndef RATE
+#define RATE 16000
+#endif
+
+#if RATE == 16000
+#define FFT_SIZE        256
+#elif RATE == 8000
+#define FFT_SIZE        128
+#else
+#error "unsupported sample rate (RATE), use 16000 or 8000"
+#endif
+
 /********************************************************************************
  * fft_size        Size of short-time window
  * fft_size_char   Size of short-time window (in number of char values)
@@ -31,29 +56,96 @@
  *   power_spec_size = 0.5 * fft_size
  ********************************************************************************/
 
-#define FFT_SIZE        256
-#define POWER_SPEC_SIZE 128
-#define FFT_SIZE_CHAR   512
+#define POWER_SPEC_SIZE (FFT_SIZE / 2)
+#define FFT_SIZE_CHAR   (FFT_SIZE * 2)
 #define HAMMING_SIZE    FFT_SIZE
 #define VECSIZE         16
 #define FEAT_VEC_SIZE   VECSIZE
 
 /********************************************************************************
- * Offset = 10ms (160 16bit-values = 320 uchars)
+ * Offset = 10ms (160 16bit-values = 320 uchars at 16 kHz)
  *
  * the distance that lies between two audio frames
  * generally, it is  offset < fft_size, and thus
  * subsequent frames do overlap!
  ********************************************************************************/
 
-#define OFFSET          320
+#define OFFSET          (RATE / 100 * 2)
+
+/********************************************************************************
+ * filter banks that reduce the power spectrum to FEAT_VEC_SIZE bands:
+ *
+ * FB_classic  the hand made bands of the original 16 kHz front end,
+ *             they need a sample rate of (at least) 16 kHz
+ * FB_mel      bands of equal width on the mel scale, up to 0.45 * RATE,
+ *             generated for the sample rate and fft size of the profile
+ *
+ * filter_bank is the one new speaker models are built with ("Filter Bank"
+ * in the configuration file), loading a speaker model switches to the
+ * one it has been built with.
+ ********************************************************************************/
+
+enum FilterBank
+{
+  FB_classic,
+  FB_mel
+};
+
+#define DEFAULT_FILTER_BANK ((RATE >= 16000) ? FB_classic : FB_mel)
+
+extern int filter_bank;
+
+/********************************************************************************
+ * preprocessFrames() handles groups of this many frames
+ * side by side, so it is fastest for multiples of it
+ ********************************************************************************/
+
+#define FRAME_BLOCK     FFT_LANES
 
-extern float hamming_window[HAMMING_SIZE];
-extern int   do_mean_sub;
+/********************************************************************************
+ * everything the preprocessing of a frame needs, set up once by
+ * createPreprocessor() and reused for any number of utterances.
+ * A context is only read while frames are preprocessed, hence one
+ * context can be used by several threads at the same time.
+ *
+ * filter_bank     filter bank the context has been set up for
+ * fft_plan        plan of the fft that is applied to each frame
+ * hamming_window  window function that each frame is multiplied with
+ * filter_start,   mel scale filter bank as a sparse weight matrix:
+ * filter_length,    band i sums up the power spectrum bins
+ * filter_offset,    filter_start[i] .. filter_start[i]+filter_length[i]-1,
+ * filter_weight     weighted by filter_weight[filter_offset[i]] ..
+ * do_mean_sub     whether channel_mean is substracted from each feature vector
+ * channel_mean    characteristics of the recording channel
+ ********************************************************************************/
+
+typedef struct
+{
+  int      filter_bank;
+  FFTPlan *fft_plan;
+  float    hamming_window[HAMMING_SIZE];
+
+  int      filter_start[FEAT_VEC_SIZE];
+  int      filter_length[FEAT_VEC_SIZE];
+  int      filter_offset[FEAT_VEC_SIZE];
+  float    filter_weight[2*POWER_SPEC_SIZE];
+
+  int      do_mean_sub;
+  float    channel_mean[FEAT_VEC_SIZE];
+} Preprocessor;
+
+/*****
+  the channel mean vector read from the configuration file
+  or estimated by calculateChannelMean()
+  *****/
 extern float channel_mean[FEAT_VEC_SIZE];
 
-int  initPreprocess();
-int  preprocessFrame(float *frame, float *result);
-void endPreprocess();
+Preprocessor       *createPreprocessor(int bank);
+void                destroyPreprocessor(Preprocessor *pp);
+void                setChannelMean(Preprocessor *pp, const float *mean);
+const Preprocessor *defaultPreprocessor();
+
+int  preprocessFrame(const Preprocessor *pp, const float *frame, float *result);
+int  preprocessFrames(const Preprocessor *pp, int n, const float *frames, float *results);
 
 #endif
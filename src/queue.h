@@ -18,28 +18,38 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
+#include <time.h>
+
 #include "semaphore.h"
 
 /*****
   states a queue item can have
+  (a 'pause'-type chunk of audio data is the first one after speech
+  has stopped, it is processed like a 'data'-type one. A 'pause'-type
+  batch of feature vectors holds the ones the utterance would end with
+  if it ended there, see speculate())
   *****/
-enum QStatus {Q_invalid, Q_start, Q_data, Q_end, Q_abort, Q_exit};
+enum QStatus {Q_invalid, Q_start, Q_data, Q_end, Q_abort, Q_exit, Q_pause};
 
 /*****
   one item of the queue consists of
-  a chunk of data, a status flag and
-  a pointer to the next queue item
+  a chunk of data (plus its size in elements),
+  a status flag, the (monotonic) capture time
+  of the data and a pointer to the next queue item
   *****/
 struct _QueueItem
 {
   void              *data;
+  int                size;
   struct _QueueItem *next;
   enum QStatus       status;
+  struct timespec    stamp;
 };
 typedef struct _QueueItem QueueItem;
 
 /*****
-  a queue knows the 'number_of_elements' it contains.
+  a queue knows the 'number_of_elements' it contains
+  and the 'total_size' of their data (in elements).
   It has a pointer to the 'head' item and the 'tail' item
   type indicates the type of data stored in the queue
   (needed for proper memory allocation etc.)
@@ -47,6 +57,7 @@ typedef struct _QueueItem QueueItem;
 typedef struct
 {
   int number_of_elements;
+  int total_size;
   QueueItem *head;
   QueueItem *tail;
   enum {T_invalid, T_char, T_float} type;
@@ -66,6 +77,7 @@ void initQueue(Queue *queue, char *type)
     and the requested type is setup, unless it is not supported!
     *****/
   queue->number_of_elements = 0;
+  queue->total_size = 0;
   queue->head = NULL;
   queue->tail = NULL;
   if (strcmp(type, "char") == 0)
@@ -106,6 +118,7 @@ void resetQueue(Queue *queue)
     free(item);
     queue->number_of_elements--;
   }
+  queue->total_size = 0;
 
   /*****
     reset head and tail to NULL pointer
@@ -121,10 +134,11 @@ void resetQueue(Queue *queue)
 }
 
 /********************************************************************************
- * append a new item to a queue
+ * append a new item to a queue, tagged with the capture time 'stamp'
+ * (stamp may be NULL if the data carries no time information)
  ********************************************************************************/
 
-void enqueue(Queue *queue, void *data, int size, int _status)
+void enqueueStamped(Queue *queue, void *data, int size, int _status, const struct timespec *stamp)
 {
   /*****
     allocate memore for new queue item
@@ -137,6 +151,15 @@ void enqueue(Queue *queue, void *data, int size, int _status)
     status of the queue item
     *****/
   new_item->status = _status;
+  new_item->size   = size;
+
+  if (stamp != NULL)
+    new_item->stamp = *stamp;
+  else
+  {
+    new_item->stamp.tv_sec  = 0;
+    new_item->stamp.tv_nsec = 0;
+  }
 
   /*****
     allocate memory for item's data depending on its type,
@@ -177,6 +200,7 @@ void enqueue(Queue *queue, void *data, int size, int _status)
     increase queue element counter by one
     *****/
   queue->number_of_elements++;
+  queue->total_size += size;
 
   semaphore_up( &queue->semaphore ); /***** new element in queue! */
 
@@ -184,10 +208,20 @@ void enqueue(Queue *queue, void *data, int size, int _status)
 }
 
 /********************************************************************************
- * remove an item from the head of a queue
+ * append a new item to a queue
  ********************************************************************************/
 
-void *dequeue(Queue *queue, enum QStatus *status)
+void enqueue(Queue *queue, void *data, int size, int _status)
+{
+  enqueueStamped(queue, data, size, _status, NULL);
+}
+
+/********************************************************************************
+ * remove an item from the head of a queue, return its capture time in
+ * 'stamp' and its size in 'size' (both only if not NULL)
+ ********************************************************************************/
+
+void *dequeueStamped(Queue *queue, enum QStatus *status, struct timespec *stamp, int *size)
 {
   void *retval = NULL;
 
@@ -200,20 +234,30 @@ void *dequeue(Queue *queue, enum QStatus *status)
     QueueItem *dequeue_item = queue->head;
     queue->head = queue->head->next;
     queue->number_of_elements--;
+    queue->total_size -= dequeue_item->size;
 
     retval = dequeue_item->data;
     *status = dequeue_item->status;
+    if (stamp != NULL)
+      *stamp = dequeue_item->stamp;
+    if (size != NULL)
+      *size = dequeue_item->size;
     free(dequeue_item);
   }
   else if (queue->number_of_elements == 1)
   {
     retval = queue->head->data;
     *status = queue->head->status;
+    if (stamp != NULL)
+      *stamp = queue->head->stamp;
+    if (size != NULL)
+      *size = queue->head->size;
     free(queue->head);
 
     queue->head               = NULL;
     queue->tail               = NULL;
     queue->number_of_elements = 0;
+    queue->total_size         = 0;
   }
   else
     status = Q_invalid;
@@ -223,6 +267,15 @@ void *dequeue(Queue *queue, enum QStatus *status)
   return retval;
 }
 
+/********************************************************************************
+ * remove an item from the head of a queue
+ ********************************************************************************/
+
+void *dequeue(Queue *queue, enum QStatus *status)
+{
+  return dequeueStamped(queue, status, NULL, NULL);
+}
+
 /********************************************************************************
  * get length of queue
  ********************************************************************************/
@@ -238,5 +291,20 @@ int numberOfElements(Queue *queue)
   return retval;
 }
 
+/********************************************************************************
+ * get the summed size of all items in a queue
+ ********************************************************************************/
+
+int totalSize(Queue *queue)
+{
+  int retval;
+
+  pthread_mutex_lock( &queue->access );   /***** get exclusive access */
+  retval = queue->total_size;
+  pthread_mutex_unlock( &queue->access ); /***** release exclusive access */
+
+  return retval;
+}
+
 #endif
 
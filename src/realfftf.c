@@ -4,15 +4,13 @@
  *        Date: 2 September 1993
  *
  * Description: These routines perform an FFT on real data.
- *              On a 486/33 compiled using Borland C++ 3.1 with full
- *              speed optimization and a small memory model, a 1024 point
- *              FFT takes about 16ms.
  *              This code is for floating point data.
  *
- *  Note: Output is BIT-REVERSED! so you must use the BitReversed to
- *        get legible output, (i.e. Real_i = buffer[ BitReversed[i] ]
- *                                  Imag_i = buffer[ BitReversed[i]+1 ] )
- *        Input is in normal order.
+ *  The transform is reentrant: all its state lives in an FFTPlan
+ *  that is not modified by realFFT(), so one plan can be shared by
+ *  any number of threads.
+ *
+ *  Input and output are in normal order (see realfftf.h).
  ********************************************************************************/
 
 #include <math.h>
@@ -21,144 +19,369 @@
 
 #include "realfftf.h"
 
-int *bit_reversed;
-float *SinTable;
-int Points = 0;
-
 /********************************************************************************
- *  Initialize the Sine table and Twiddle pointers (bit-reversed pointers)
- *  for the FFT routine.
+ *  Create a plan for FFTs of 'fftlen' real values (a power of two >= 4),
+ *  returns NULL on error.
  ********************************************************************************/
 
-void initialize_FFT(int fftlen)
+FFTPlan *createFFTPlan(int fftlen)
 {
-  int i;
-  int temp;
-  int mask;
+  FFTPlan *plan;
+  int points = fftlen/2;
+  int i, mask, temp;
 
   /*****
    *  FFT size is only half the number of data points
    *  The full FFT output can be reconstructed from this FFT's output.
    *  (This optimization can be made since the data is real.)
    *****/
-  Points = fftlen/2;
+  if (points < 2 || (points & (points-1)) != 0)
+  {
+    fprintf(stderr, "FFT size must be a power of two: %d\n", fftlen);
+    return NULL;
+  }
 
-  if((SinTable=(float *)malloc(2*Points*sizeof(float)))==NULL)
+  if ((plan = (FFTPlan *)malloc(sizeof(FFTPlan))) == NULL)
   {
-    puts("Error allocating memory for Sine table.");
-    exit(1);
+    fprintf(stderr, "Error allocating memory for FFT plan.\n");
+    return NULL;
   }
-  if((bit_reversed=(int *)malloc(Points*sizeof(int)))==NULL)
+
+  plan->points       = points;
+  plan->bit_reversed = (int *)malloc(points*sizeof(int));
+  plan->twiddle      = (fft_type *)malloc(2*points*sizeof(fft_type));
+  plan->split        = (fft_type *)malloc(2*points*sizeof(fft_type));
+
+  if (plan->bit_reversed == NULL || plan->twiddle == NULL || plan->split == NULL)
   {
-    puts("Error allocating memory for bit_reversed.");
-    exit(1);
+    fprintf(stderr, "Error allocating memory for FFT plan.\n");
+    destroyFFTPlan(plan);
+    return NULL;
   }
 
-  for(i=0;i<Points;i++)
+  for (i = 0; i < points; i++)
   {
-    temp=0;
-    for(mask=Points/2;mask>0;mask >>= 1)
-      temp=(temp >> 1) + (i&mask ? Points : 0);
+    temp = 0;
+    for (mask = 1; mask < points; mask <<= 1)
+      temp = (temp << 1) | ((i & mask) ? 1 : 0);
 
-    bit_reversed[i]=temp;
+    plan->bit_reversed[i] = temp;
   }
 
-  for(i=0;i<Points;i++)
+  for (i = 0; i < points; i++)
   {
-    SinTable[bit_reversed[i]  ]=-sin(2*M_PI*i/(2*Points));
-    SinTable[bit_reversed[i]+1]=-cos(2*M_PI*i/(2*Points));
+    plan->twiddle[2*i  ] =  cos(2*M_PI*i/points);
+    plan->twiddle[2*i+1] = -sin(2*M_PI*i/points);
+    plan->split[2*i  ]   =  cos(2*M_PI*i/(2*points));
+    plan->split[2*i+1]   = -sin(2*M_PI*i/(2*points));
   }
+
+  return plan;
 }
 
 /********************************************************************************
- *  Free up the memory allotted for Sin table and Twiddle Pointers
+ *  Free up the memory allotted for a plan
  ********************************************************************************/
 
-void end_FFT()
+void destroyFFTPlan(FFTPlan *plan)
 {
-  free(bit_reversed);
-  free(SinTable);
-  Points=0;
-}
+  if (plan == NULL)
+    return;
 
-float *A,*B;
-float *sptr;
-float *endptr1,*endptr2;
-int *br1,*br2;
-float HRplus,HRminus,HIplus,HIminus;
+  free(plan->bit_reversed);
+  free(plan->twiddle);
+  free(plan->split);
+  free(plan);
+}
 
 /********************************************************************************
- *  Actual FFT routine.  Must call InitializeFFT(fftlen) first!
+ *  Actual FFT routine: transform the 2*points real values in 'in'
+ *  into the spectrum 'out' (2*points values, must not overlap 'in')
  ********************************************************************************/
 
-void real_FFT(float *buffer)
+void realFFT(const FFTPlan *plan, const fft_type *in, fft_type *out)
 {
-  int ButterfliesPerGroup=Points/2;
+  const int       points  = plan->points;
+  const fft_type *twiddle = plan->twiddle;
+  int L, m, s, k, step;
 
-  endptr1=buffer+Points*2;
+  /*****
+   *  Load the real values as complex pairs (even/odd value)
+   *  in bit-reversed order, so the result comes out in normal order.
+   *****/
+  for (k = 0; k < points; k++)
+  {
+    out[2*plan->bit_reversed[k]  ] = in[2*k];
+    out[2*plan->bit_reversed[k]+1] = in[2*k+1];
+  }
 
   /*****
-   *  Butterfly:
-   *     Ain-----Aout
-   *         \ /
-   *         / \
-   *     Bin-----Bout
+   *  one radix-2 stage, if log2(points) is odd
    *****/
+  for (m = points; m > 2; m >>= 2)
+    ;
+  L = 1;
+  if (m == 2)
+  {
+    for (s = 0; s < 2*points; s += 4)
+    {
+      fft_type ar = out[s  ], ai = out[s+1];
+      fft_type br = out[s+2], bi = out[s+3];
+
+      out[s  ] = ar + br;
+      out[s+1] = ai + bi;
+      out[s+2] = ar - br;
+      out[s+3] = ai - bi;
+    }
+    L = 2;
+  }
 
-  while(ButterfliesPerGroup>0)
+  /*****
+   *  radix-4 stages: four transforms of length L are combined into one
+   *  of length 4L. Due to the bit-reversed order, the four transforms
+   *  (of every 4th value starting at 0, 1, 2, 3) are stored in the
+   *  order 0, 2, 1, 3.
+   *
+   *     X[k]    = A0 +   t1 + t2 +   t3
+   *     X[k+L]  = A0 - i*t1 - t2 + i*t3
+   *     X[k+2L] = A0 -   t1 + t2 -   t3      with  tn = An * W^(n*k)
+   *     X[k+3L] = A0 + i*t1 - t2 - i*t3            W  = exp(-2*pi*i/4L)
+   *****/
+  for (; L < points; L *= 4)
   {
-    A=buffer;
-    B=buffer+ButterfliesPerGroup*2;
-    sptr=SinTable;
+    step = points/(4*L);
 
-    while(A<endptr1)
+    for (s = 0; s < points; s += 4*L)
     {
-      register float sin=*sptr;
-      register float cos=*(sptr+1);
-      endptr2=B;
-      while(A<endptr2)
+      fft_type *a0 = out + 2*s;
+      fft_type *a2 = a0 + 2*L;
+      fft_type *a1 = a0 + 4*L;
+      fft_type *a3 = a0 + 6*L;
+
+      for (k = 0; k < L; k++)
       {
-	float v1=*B*cos + *(B+1)*sin;
-	float v2=*B*sin - *(B+1)*cos;
-	*B=(*A+v1)*0.5;
-	*(A++)=*(B++)-v1;
-	*B=(*A-v2)*0.5;
-	*(A++)=*(B++)+v2;
+        const fft_type *w1 = twiddle + 2*k*step;
+        const fft_type *w2 = twiddle + 4*k*step;
+        const fft_type *w3 = twiddle + 6*k*step;
+
+        fft_type t1r = a1[2*k]*w1[0] - a1[2*k+1]*w1[1];
+        fft_type t1i = a1[2*k]*w1[1] + a1[2*k+1]*w1[0];
+        fft_type t2r = a2[2*k]*w2[0] - a2[2*k+1]*w2[1];
+        fft_type t2i = a2[2*k]*w2[1] + a2[2*k+1]*w2[0];
+        fft_type t3r = a3[2*k]*w3[0] - a3[2*k+1]*w3[1];
+        fft_type t3i = a3[2*k]*w3[1] + a3[2*k+1]*w3[0];
+
+        fft_type s02r = a0[2*k] + t2r, s02i = a0[2*k+1] + t2i;
+        fft_type d02r = a0[2*k] - t2r, d02i = a0[2*k+1] - t2i;
+        fft_type s13r = t1r + t3r,     s13i = t1i + t3i;
+        fft_type d13r = t1r - t3r,     d13i = t1i - t3i;
+
+        a0[2*k  ] = s02r + s13r;     /***** X[k]    */
+        a0[2*k+1] = s02i + s13i;
+        a2[2*k  ] = d02r + d13i;     /***** X[k+L]  */
+        a2[2*k+1] = d02i - d13r;
+        a1[2*k  ] = s02r - s13r;     /***** X[k+2L] */
+        a1[2*k+1] = s02i - s13i;
+        a3[2*k  ] = d02r - d13i;     /***** X[k+3L] */
+        a3[2*k+1] = d02i + d13r;
       }
-      A=B;
-      B+=ButterfliesPerGroup*2;
-      sptr+=2;
     }
-    ButterfliesPerGroup >>= 1;
   }
+
   /*****
-   *  Massage output to get the output for a real input sequence.
+   *  Massage output to get the output for a real input sequence:
+   *  with Z = complex FFT and Zc[k] = conj(Z[points-k]) we have
+   *     Fe  = (Z[k] + Zc[k]) / 2        (spectrum of the even values)
+   *     Fo  = (Z[k] - Zc[k]) / 2i       (spectrum of the odd values)
+   *     X[k]        = Fe + exp(-2*pi*i*k/fftlen) * Fo
+   *     X[points-k] = conj(Fe - exp(-2*pi*i*k/fftlen) * Fo)
+   *  all scaled by 1/points.
    *****/
-  br1=bit_reversed+1;
-  br2=bit_reversed+Points-1;
-
-  while(br1<=br2)
-  {
-    register float temp1;
-    register float temp2;
-    float sin=SinTable[*br1];
-    float cos=SinTable[*br1+1];
-    A=buffer+*br1;
-    B=buffer+*br2;
-    HRplus = (HRminus = *A     - *B    ) + (*B     * 2);
-    HIplus = (HIminus = *(A+1) - *(B+1)) + (*(B+1) * 2);
-    temp1  = (sin*HRminus - cos*HIplus);
-    temp2  = (cos*HRminus + sin*HIplus);
-    *B     = (*A     = (HRplus  + temp1) * 0.5) - temp1;
-    *(B+1) = (*(A+1) = (HIminus + temp2) * 0.5) - HIminus;
-
-    br1++;
-    br2--;
+  for (k = 1; k <= points/2; k++)
+  {
+    fft_type *x = out + 2*k;
+    fft_type *y = out + 2*(points-k);
+    fft_type  h = 0.5/points;
+
+    fft_type fer = (x[0] + y[0])*h, fei = (x[1] - y[1])*h;
+    fft_type for_ = (x[1] + y[1])*h, foi = (y[0] - x[0])*h;
+    fft_type wr = plan->split[2*k], wi = plan->split[2*k+1];
+    fft_type tr = wr*for_ - wi*foi;
+    fft_type ti = wr*foi  + wi*for_;
+
+    y[0] =   fer - tr;
+    y[1] = -(fei - ti);
+    x[0] =   fer + tr;
+    x[1] =   fei + ti;
   }
+
   /*****
-   *  Handle DC bin separately
+   *  Handle DC bin separately (the Nyquist bin is dropped)
    *****/
-  buffer[0]+=buffer[1];
-  buffer[1]=0;
+  out[0] = (out[0] + out[1])/points;
+  out[1] = 0;
+}
+
+/********************************************************************************
+ *  Building blocks of realFFTLanes(): each one does one step of realFFT()
+ *  for all lanes. The pointers never overlap, telling the compiler so
+ *  lets it turn the lane loops into vector instructions.
+ ********************************************************************************/
+
+static inline void radix2Lanes(fft_type *restrict a, fft_type *restrict b)
+{
+  int l;
+
+  for (l = 0; l < FFT_LANES; l++)
+  {
+    fft_type ar = a[l], ai = a[FFT_LANES+l];
+    fft_type br = b[l], bi = b[FFT_LANES+l];
+
+    a[l]           = ar + br;
+    a[FFT_LANES+l] = ai + bi;
+    b[l]           = ar - br;
+    b[FFT_LANES+l] = ai - bi;
+  }
+}
+
+static inline void radix4Lanes(fft_type *restrict a0, fft_type *restrict a1,
+                               fft_type *restrict a2, fft_type *restrict a3,
+                               const fft_type *w1, const fft_type *w2, const fft_type *w3)
+{
+  const fft_type w1r = w1[0], w1i = w1[1];
+  const fft_type w2r = w2[0], w2i = w2[1];
+  const fft_type w3r = w3[0], w3i = w3[1];
+  int l;
+
+  for (l = 0; l < FFT_LANES; l++)
+  {
+    fft_type t1r = a1[l]*w1r - a1[FFT_LANES+l]*w1i;
+    fft_type t1i = a1[l]*w1i + a1[FFT_LANES+l]*w1r;
+    fft_type t2r = a2[l]*w2r - a2[FFT_LANES+l]*w2i;
+    fft_type t2i = a2[l]*w2i + a2[FFT_LANES+l]*w2r;
+    fft_type t3r = a3[l]*w3r - a3[FFT_LANES+l]*w3i;
+    fft_type t3i = a3[l]*w3i + a3[FFT_LANES+l]*w3r;
+
+    fft_type s02r = a0[l] + t2r, s02i = a0[FFT_LANES+l] + t2i;
+    fft_type d02r = a0[l] - t2r, d02i = a0[FFT_LANES+l] - t2i;
+    fft_type s13r = t1r + t3r,   s13i = t1i + t3i;
+    fft_type d13r = t1r - t3r,   d13i = t1i - t3i;
+
+    a0[l]           = s02r + s13r;     /***** X[k]    */
+    a0[FFT_LANES+l] = s02i + s13i;
+    a2[l]           = d02r + d13i;     /***** X[k+L]  */
+    a2[FFT_LANES+l] = d02i - d13r;
+    a1[l]           = s02r - s13r;     /***** X[k+2L] */
+    a1[FFT_LANES+l] = s02i - s13i;
+    a3[l]           = d02r - d13i;     /***** X[k+3L] */
+    a3[FFT_LANES+l] = d02i + d13r;
+  }
+}
+
+static inline void splitLanes(fft_type *restrict x, fft_type *restrict y,
+                              const fft_type *w, fft_type h)
+{
+  const fft_type wr = w[0], wi = w[1];
+  int l;
+
+  for (l = 0; l < FFT_LANES; l++)
+  {
+    fft_type fer = (x[l] + y[l])*h, fei = (x[FFT_LANES+l] - y[FFT_LANES+l])*h;
+    fft_type for_ = (x[FFT_LANES+l] + y[FFT_LANES+l])*h, foi = (y[l] - x[l])*h;
+    fft_type tr = wr*for_ - wi*foi;
+    fft_type ti = wr*foi  + wi*for_;
+
+    y[l]           =   fer - tr;
+    y[FFT_LANES+l] = -(fei - ti);
+    x[l]           =   fer + tr;
+    x[FFT_LANES+l] =   fei + ti;
+  }
 }
 
+/********************************************************************************
+ *  The same FFT for FFT_LANES inputs at once ('in' holds them one after
+ *  the other, 'out' gets the interleaved spectra)
+ ********************************************************************************/
+
+void realFFTLanes(const FFTPlan *plan, const fft_type *in, fft_type *out)
+{
+  const int       points  = plan->points;
+  const fft_type *twiddle = plan->twiddle;
+  const fft_type  h       = 0.5/points;
+  int L, m, s, k, l, step;
+
+  /*****
+   *  Interleave the inputs and load them in bit-reversed order
+   *  (the re/im pair of all lanes is one contiguous block)
+   *****/
+  for (k = 0; k < points; k++)
+  {
+    fft_type *dst = out + 2*FFT_LANES*plan->bit_reversed[k];
+
+    for (l = 0; l < FFT_LANES; l++)
+    {
+      dst[l]           = in[2*points*l + 2*k];
+      dst[FFT_LANES+l] = in[2*points*l + 2*k+1];
+    }
+  }
+
+  /*****
+   *  one radix-2 stage, if log2(points) is odd
+   *****/
+  for (m = points; m > 2; m >>= 2)
+    ;
+  L = 1;
+  if (m == 2)
+  {
+    for (s = 0; s < points; s += 2)
+      radix2Lanes(out + 2*FFT_LANES*s, out + 2*FFT_LANES*(s+1));
+    L = 2;
+  }
+
+  /*****
+   *  radix-4 stages (see realFFT())
+   *****/
+  for (; L < points; L *= 4)
+  {
+    step = points/(4*L);
+
+    for (s = 0; s < points; s += 4*L)
+      for (k = 0; k < L; k++)
+      {
+        fft_type *a0 = out + 2*FFT_LANES*(s+k);
+
+        radix4Lanes(a0, a0 + 4*FFT_LANES*L, a0 + 2*FFT_LANES*L, a0 + 6*FFT_LANES*L,
+                    twiddle + 2*k*step, twiddle + 4*k*step, twiddle + 6*k*step);
+      }
+  }
+
+  /*****
+   *  Massage output to get the output for a real input sequence,
+   *  the bin in the middle is its own mirror image
+   *****/
+  for (k = 1; k < points/2; k++)
+    splitLanes(out + 2*FFT_LANES*k, out + 2*FFT_LANES*(points-k), plan->split + 2*k, h);
+
+  {
+    fft_type *x = out + 2*FFT_LANES*(points/2);
+    fft_type wr = plan->split[points], wi = plan->split[points+1];
+
+    for (l = 0; l < FFT_LANES; l++)
+    {
+      fft_type fer = (x[l] + x[l])*h, fei = (x[FFT_LANES+l] - x[FFT_LANES+l])*h;
+      fft_type for_ = (x[FFT_LANES+l] + x[FFT_LANES+l])*h, foi = (x[l] - x[l])*h;
+
+      x[l]           = fer + (wr*for_ - wi*foi);
+      x[FFT_LANES+l] = fei + (wr*foi  + wi*for_);
+    }
+  }
+
+  /*****
+   *  Handle DC bin separately (the Nyquist bin is dropped)
+   *****/
+  for (l = 0; l < FFT_LANES; l++)
+  {
+    out[l]           = (out[l] + out[FFT_LANES+l])/points;
+    out[FFT_LANES+l] = 0;
+  }
+}
@@ -4,15 +4,21 @@
  *        Date: 2 September 1993
  *
  * Description: These routines perform an FFT on real data.
- *              On a 486/33 compiled using Borland C++ 3.1 with full
- *              speed optimization and a small memory model, a 1024 point
- *              FFT takes about 16ms.
  *              This code is for floating point data.
  *
- *  Note: Output is BIT-REVERSED! so you must use the BitReversed to
- *        get legible output, (i.e. Real_i = buffer[ BitReversed[i] ]
- *                                  Imag_i = buffer[ BitReversed[i]+1 ] )
- *        Input is in normal order.
+ *  The transform of a given size is described by a plan, which is
+ *  created once and is never modified afterwards. Hence one plan
+ *  can be used by any number of threads at the same time.
+ *
+ *  Input is in normal order, output is in normal order as well:
+ *    Real_i = out[2*i], Imag_i = out[2*i+1]   (i = 0 .. fftlen/2-1)
+ *  The Nyquist bin is dropped, i.e. out[1] (Imag_0) is always 0.
+ *  The output is scaled by 2/fftlen.
+
+  realFFTLanes() transforms FFT_LANES inputs at once, stored one after
+  the other in 'in'. The spectra are interleaved value by value:
+  value i of spectrum l is out[i*FFT_LANES+l]. Each of them is exactly
+  what realFFT() would compute for its input.
  ********************************************************************************/
 
 #ifndef REALFFTF_H
@@ -20,10 +26,32 @@
 
 typedef float fft_type;
 
-extern int *bit_reversed;
+/*****
+  number of transforms realFFTLanes() computes side by side
+  *****/
+#define FFT_LANES 8
+
+/*****
+  plan for a real FFT of 'fftlen' = 2*points values:
+  the data is transformed by a complex FFT of 'points' values
+  (radix-4 stages, plus one radix-2 stage if log2(points) is odd),
+  whose result is split into the spectrum of the real input.
+
+  bit_reversed  bit reversed index of each complex input value
+  twiddle       exp(-2*pi*i*k/points),  k = 0 .. points-1 (re/im pairs)
+  split         exp(-2*pi*i*k/fftlen),  k = 0 .. points-1 (re/im pairs)
+  *****/
+typedef struct
+{
+  int       points;
+  int      *bit_reversed;
+  fft_type *twiddle;
+  fft_type *split;
+} FFTPlan;
 
-void initialize_FFT(int);
-void end_FFT(void);
-void real_FFT(fft_type *);
+FFTPlan *createFFTPlan(int fftlen);
+void     destroyFFTPlan(FFTPlan *plan);
+void     realFFT(const FFTPlan *plan, const fft_type *in, fft_type *out);
+void     realFFTLanes(const FFTPlan *plan, const fft_type *in, fft_type *out);
 
 #endif
@@ -0,0 +1,185 @@
+/***************************************************************************
+                          realtime.c  -  scheduling, cpu placement and
+                                         memory locking of the recognizer
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "realtime.h"
+
+static const char *thread_name[T_number_of_threads] = {
+    "record", "preprocess", "recognize", "worker"
+};
+
+static const char *deadline_name[D_number_of_deadlines] = {
+    "capture", "recognize"
+};
+
+static volatile int deadline_misses[D_number_of_deadlines];
+
+/********************************************************************************
+ * parse a list of CPUs like "0,2-3" into a cpu set,
+ * returns the number of CPUs in the set (0 on error)
+ ********************************************************************************/
+
+static int parseCpuList( const char *s, cpu_set_t *set )
+{
+    char *end;
+    long from, to;
+
+    CPU_ZERO( set );
+
+    while( *s != '\0' )
+    {
+        while( *s == ' ' || *s == ',' ) s++;
+        if( *s == '\0' ) break;
+
+        from = strtol( s, &end, 10 );
+        if( end == s || from < 0 ) return 0;
+        to = from;
+        s = end;
+        if( *s == '-' )
+        {
+            s++;
+            to = strtol( s, &end, 10 );
+            if( end == s || to < from ) return 0;
+            s = end;
+        }
+        if( to >= CPU_SETSIZE ) return 0;
+        for( ; from <= to; from++ ) CPU_SET( from, set );
+    }
+
+    return CPU_COUNT( set );
+}
+
+/********************************************************************************
+ * apply the configured scheduling policy and CPU placement
+ * to the calling thread (failures are reported, but not fatal)
+ ********************************************************************************/
+
+void setupThread( enum PipelineThread t )
+{
+    cpu_set_t set;
+    int ret;
+
+    if( thread_cpus[t][0] != '\0' )
+    {
+        if( parseCpuList( thread_cpus[t], &set ) == 0 )
+            fprintf( stderr, "Invalid CPU list for %s thread: %s\n", thread_name[t],
+                     thread_cpus[t] );
+        else if( ( ret = pthread_setaffinity_np( pthread_self(  ), sizeof( set ), &set ) ) != 0 )
+            fprintf( stderr, "Failed to pin %s thread to CPUs %s: %s\n", thread_name[t],
+                     thread_cpus[t], strerror( ret ) );
+    }
+
+    if( t == T_record && capture_policy != SCHED_OTHER )
+    {
+        struct sched_param param;
+
+        memset( &param, 0, sizeof( param ) );
+        param.sched_priority = capture_priority;
+
+        if( ( ret = pthread_setschedparam( pthread_self(  ), capture_policy, &param ) ) != 0 )
+            fprintf( stderr, "Failed to set real-time priority %d for %s thread: %s\n",
+                     capture_priority, thread_name[t], strerror( ret ) );
+    }
+}
+
+/********************************************************************************
+ * lock all current and future pages of the process in memory
+ * and pre-fault the speaker model plus its DTW matrices,
+ * so that no page fault happens during recognition
+ ********************************************************************************/
+
+int lockMemory( Model *model )
+{
+    volatile float sum = 0;
+    int i, j, k;
+
+    if( mlockall( MCL_CURRENT | MCL_FUTURE ) != 0 )
+    {
+        fprintf( stderr, "Failed to lock memory: %s\n", strerror( errno ) );
+        return 0;
+    }
+
+    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
+    {
+        ModelItemSample *sample = model->direct[i];
+
+        for( j = 0; j < sample->length; j++ )
+            sum += sample->data[j][0];
+
+        for( k = 0; k < 3; k++ )
+            if( sample->matrix[k] != NULL )
+                memset( sample->matrix[k], 0, sizeof( float ) * sample->length );
+    }
+
+    return 1;
+}
+
+/********************************************************************************
+ * count a missed deadline (may be called from any thread)
+ ********************************************************************************/
+
+void deadlineMissed( enum Deadline d )
+{
+    __sync_fetch_and_add( &deadline_misses[d], 1 );
+}
+
+/********************************************************************************
+ * print the number of missed deadlines
+ ********************************************************************************/
+
+void reportDeadlineMisses( FILE *f )
+{
+    int d;
+
+    fprintf( f, "deadline misses:" );
+    for( d = 0; d < D_number_of_deadlines; d++ )
+        fprintf( f, " %s %d", deadline_name[d], deadline_misses[d] );
+    fprintf( f, "\n" );
+}
+
+/********************************************************************************
+ * print the CPU time and the context switches of the whole process,
+ * e.g. to compare the threaded and the single-thread mode on the same input,
+ * plus the CPU time per hour of audio data if 'captured' seconds have been read
+ ********************************************************************************/
+
+void reportCpuUsage( FILE *f, double captured )
+{
+    struct rusage usage;
+    double cpu;
+
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 ) return;
+
+    cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+
+    fprintf( f, "cpu time: user %.3f s, system %.3f s, context switches: %ld voluntary, %ld involuntary\n",
+             usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0,
+             usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0,
+             usage.ru_nvcsw, usage.ru_nivcsw );
+    if( captured > 0 )
+        fprintf( f, "cpu time per hour of audio: %.1f s (%.0f s of audio)\n", cpu * 3600 / captured, captured );
+}
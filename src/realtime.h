@@ -0,0 +1,78 @@
+/***************************************************************************
+                          realtime.h  -  scheduling, cpu placement and
+                                         memory locking of the recognizer
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stdio.h>
+
+#include "model.h"
+
+/********************************************************************************
+ * the threads of the recognizer pipeline.
+ * The scheduling policy and priority only apply to the capture
+ * (record) thread, every stage can be pinned to a set of CPUs.
+ * The settings are read from the configuration file:
+ *
+ *   Capture Scheduling = other | fifo | rr
+ *   Capture Priority   = 1 .. 99            (fifo and rr only)
+ *   Record CPUs        = e.g. 0 or 0,2-3    (empty: no pinning)
+ *   Preprocess CPUs    = ...
+ *   Recognize CPUs     = ...
+ *   Worker CPUs        = ...                (DTW worker threads)
+ *   Lock Memory        = 0 | 1              (mlockall + pre-fault model)
+ ********************************************************************************/
+
+enum PipelineThread {
+    T_record,
+    T_preprocess,
+    T_recognize,
+    T_worker,
+    T_number_of_threads
+};
+
+/********************************************************************************
+ * deadlines that are monitored:
+ *
+ * D_capture    the recording thread did not get the next block in time
+ *              (gap between two capture time stamps > 1.5 block durations)
+ * D_recognize  the recognizer needed longer for a batch of feature frames
+ *              than their frame shifts (time-synchronous decoding falls behind)
+ ********************************************************************************/
+
+enum Deadline {
+    D_capture,
+    D_recognize,
+    D_number_of_deadlines
+};
+
+#define CPU_LIST_SIZE 80
+
+/***** set in configuration.c */
+
+extern int  capture_policy;
+extern int  capture_priority;
+extern char thread_cpus[T_number_of_threads][CPU_LIST_SIZE];
+extern int  lock_memory;
+
+void setupThread( enum PipelineThread t );
+int  lockMemory( Model *model );
+
+void deadlineMissed( enum Deadline d );
+void reportDeadlineMisses( FILE *f );
+void reportCpuUsage( FILE *f, double captured );
+
+#endif
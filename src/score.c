@@ -19,6 +19,7 @@
 #include "score.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 /*
 # include <sys/types.h>
@@ -26,14 +27,41 @@
 */
 
 /********************************************************************************
- * initialize the score queue
+ * initialize the score queue for up to 'capacity' hypotheses (the number
+ * of sample utterances) of references 0 .. number_of_refs-1
  ********************************************************************************/
 
-void initScoreQueue(ScoreQueue *queue)
+void initScoreQueue(ScoreQueue *queue, int capacity, int number_of_refs)
 {
+  /***** all memory is allocated here, none per hypothesis */
+
+  queue->capacity = capacity;
+  queue->top = (ScoreQueueItem *)malloc(sizeof(ScoreQueueItem) * capacity);
+
+  queue->number_of_refs = number_of_refs;
+  queue->best  = (float *)malloc(sizeof(float) * number_of_refs);
+  queue->count = (int *)calloc(number_of_refs, sizeof(int));
+
   queue->length = 0;    /***** set reasonable initial values */
-  queue->first  = NULL;
-};
+  queue->top_N  = 0;
+}
+
+/********************************************************************************
+ * free the memory of the score queue
+ ********************************************************************************/
+
+void endScoreQueue(ScoreQueue *queue)
+{
+  free(queue->top);
+  free(queue->best);
+  free(queue->count);
+
+  queue->top   = NULL;
+  queue->best  = NULL;
+  queue->count = NULL;
+  queue->capacity = queue->number_of_refs = 0;
+  queue->length = queue->top_N = 0;
+}
 
 /********************************************************************************
  * empty the score queue
@@ -41,18 +69,18 @@ void initScoreQueue(ScoreQueue *queue)
 
 void resetScoreQueue(ScoreQueue *queue)
 {
-  /***** while there are elements in the queue left ... */
+  int i;
 
-  while (queue->first != NULL)
-  {
-    /***** ... remove the first element */
+  /***** only the references that got hypotheses have to be cleared */
 
-    ScoreQueueItem *tmp_item = queue->first;
-    queue->first = queue->first->next;
-    free(tmp_item);
-  }
+  if (queue->length > queue->top_N)
+    memset(queue->count, 0, sizeof(int) * queue->number_of_refs);
+  else
+    for (i = 0; i < queue->top_N; i++)
+      queue->count[queue->top[i].id] = 0;
 
   queue->length = 0; /***** queue is empty now */
+  queue->top_N  = 0;
 }
 
 /********************************************************************************
@@ -61,37 +89,56 @@ void resetScoreQueue(ScoreQueue *queue)
 
 void insertInScoreQueue(ScoreQueue *queue, float score, int ref_index)
 {
-  /***** allocate a new score object according to the specified parameters */
+  int pos;
 
-  ScoreQueueItem *new_score = (ScoreQueueItem *)malloc(sizeof(ScoreQueueItem));
-  new_score->score = score;
-  new_score->id    = ref_index;
-  new_score->next  = NULL;
+  /***** keep track of the reference */
+
+  if (queue->count[ref_index] == 0 || score < queue->best[ref_index])
+    queue->best[ref_index] = score;
+  queue->count[ref_index]++;
+  queue->length++;
 
   /*****
-   * find the appropriate place in the queue,
-   * so that the queue is sorted by increasing scores
+   * the hypothesis goes before all the ones with a score that is not
+   * lower. The recognizer inserts at most one per sample utterance, so
+   * the queue doesn't fill up; if it did, only the best ones were kept.
    *****/
-  if (queue->first == NULL)               /***** first case: queue is empty */
-    queue->first = new_score;
-  else if (queue->first->score >= score)  /***** second case: new item is the new head item of the queue */
+  if (queue->top_N == queue->capacity)
   {
-    new_score->next = queue->first;
-    queue->first = new_score;
+    if (queue->capacity == 0 || queue->top[queue->capacity-1].score < score)
+      return;
+    queue->top_N--;                     /***** the last one drops out */
   }
-  else                                    /***** third case: item has to be put inside the queue */
-  {
-    ScoreQueueItem *tmp_queue = queue->first;
 
-    while (tmp_queue->next != NULL && tmp_queue->next->score < score)
-      tmp_queue = tmp_queue->next;
-    new_score->next = tmp_queue->next;
-    tmp_queue->next = new_score;
+  pos = queue->top_N;
+  while (pos > 0 && queue->top[pos-1].score >= score)
+  {
+    queue->top[pos] = queue->top[pos-1];
+    pos--;
   }
+  queue->top[pos].score = score;
+  queue->top[pos].id    = ref_index;
 
-  queue->length++; /***** adjust length of queue */
+  queue->top_N++;
 }
 
+/********************************************************************************
+ * are all hypotheses of reference 'id' in the first half of the queue
+ * (not counting the first two)?
+ ********************************************************************************/
+
+static int inFirstHalf(ScoreQueue *queue, int id)
+{
+  int i, last = 0;
+
+  /***** position of the last hypothesis of 'id' */
+
+  for (i = 0; i < queue->top_N; i++)
+    if (queue->top[i].id == id)
+      last = i+1;
+
+  return (last < 3 || last <= queue->length/2);
+}
 
 /********************************************************************************
  * interpret contents of score_queue
@@ -99,6 +146,7 @@ void insertInScoreQueue(ScoreQueue *queue, float score, int ref_index)
 
 int getResultID(ScoreQueue *queue)
 {
+    ScoreQueueItem *top = queue->top;
     int id = -1;
 
   /*****
@@ -114,13 +162,13 @@ int getResultID(ScoreQueue *queue)
     }
     else if (queue->length == 1)
     {
-	id = queue->first->id;
+	id = top[0].id;
     }
     else if (queue->length == 2)
     {
-	if (queue->first->id == queue->first->next->id)
+	if (top[0].id == top[1].id)
 	{
-	    id = queue->first->id;
+	    id = top[0].id;
 	}
 	else
 	{
@@ -129,43 +177,25 @@ int getResultID(ScoreQueue *queue)
     }
     else if (queue->length >= 3)
     {
-	if (queue->first->id == queue->first->next->id &&
-	    queue->first->next->id == queue->first->next->next->id)
+	if (top[0].id == top[1].id &&
+	    top[1].id == top[2].id)
 	{
-	    id = queue->first->id;
+	    id = top[0].id;
 	}
-	else if (queue->first->id == queue->first->next->id)
+	else if (top[0].id == top[1].id)
 	{
-	    if (1.0*(queue->first->next->next->score - queue->first->next->score) >=
-		2.0*(queue->first->next->score - queue->first->score))
+	    if (1.0*(top[2].score - top[1].score) >=
+		2.0*(top[1].score - top[0].score))
 	    {
-		id = queue->first->id;
+		id = top[0].id;
+	    }
+	    else if (inFirstHalf(queue, top[0].id))
+	    {
+		id = top[0].id;
 	    }
 	    else
 	    {
-		ScoreQueueItem *tmp_item = queue->first->next->next;
-		int ok = 1;
-		int count = 3;
-		while (tmp_item != NULL)
-		{
-		    if (tmp_item->id == queue->first->id && count > queue->length/2)
-		    {
-			ok = 0;
-			break;
-		    }
-
-		    tmp_item = tmp_item->next;
-		    count++;
-		}
-
-		if (ok)
-		{
-		    id = queue->first->id;
-		}
-		else
-		{
-		    id = -1;
-		}
+		id = -1;
 	    }
 	}
 	else
@@ -180,3 +210,58 @@ int getResultID(ScoreQueue *queue)
 
     return id;
 }
+
+/********************************************************************************
+ * write the (at most) 'n' best references to 'nbest', sorted by their
+ * best score, returns their number
+ ********************************************************************************/
+
+int getNBest(ScoreQueue *queue, ScoreResult *nbest, int n)
+{
+  int i, k, found = 0;
+
+  /***** the best ones come from the list, in its order */
+
+  for (i = 0; i < queue->top_N && found < n; i++)
+  {
+    for (k = 0; k < found && nbest[k].id != queue->top[i].id; k++)
+      ;
+    if (k < found)
+      continue;
+
+    nbest[found].id    = queue->top[i].id;
+    nbest[found].score = queue->top[i].score;
+    found++;
+  }
+
+  /***** the list may be too short if there are many hypotheses */
+
+  while (found < n && queue->length > queue->top_N)
+  {
+    int best_id = -1;
+
+    for (i = 0; i < queue->number_of_refs; i++)
+    {
+      if (queue->count[i] == 0 || (best_id >= 0 && queue->best[i] >= queue->best[best_id]))
+	continue;
+      for (k = 0; k < found && nbest[k].id != i; k++)
+	;
+      if (k == found)
+	best_id = i;
+    }
+    if (best_id < 0)
+      break;
+
+    nbest[found].id    = best_id;
+    nbest[found].score = queue->best[best_id];
+    found++;
+  }
+
+  for (i = 0; i < found; i++)
+  {
+    nbest[i].margin = nbest[i].score - nbest[0].score;
+    nbest[i].count  = queue->count[nbest[i].id];
+  }
+
+  return found;
+}
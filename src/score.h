@@ -22,31 +22,54 @@
 #include "model.h"
 
 /****
-  a queue of recognition scores,
-  the queue elements are sorted by increasing
-  score. The final recognition result can be
-  obtained from this queue
+  a queue of recognition scores:
+  the hypotheses (at most one per sample utterance,
+  the capacity) are kept in an array allocated once,
+  sorted by increasing score (the newest first
+  among equal scores). For each reference the
+  best score and the number of hypotheses are
+  kept as well. The final recognition result
+  can be obtained from this queue
   *****/
-struct _ScoreQueueItem
+typedef struct
 {
   float score;
   int   id;
-  struct _ScoreQueueItem *next;
-};
-typedef struct _ScoreQueueItem ScoreQueueItem;
+} ScoreQueueItem;
 
 typedef struct
 {
-  int length;
+  int length;           /***** number of hypotheses inserted */
+
+  ScoreQueueItem *top;  /***** the hypotheses */
+  int top_N;
+  int capacity;
 
-  ScoreQueueItem *first;
+  int    number_of_refs;
+  float *best;          /***** best score of each reference */
+  int   *count;         /***** number of hypotheses of each reference */
 } ScoreQueue;
 
-void initScoreQueue(ScoreQueue *queue);
+/****
+  an entry of the N-best list of references,
+  margin is the distance of its score to the
+  score of the best reference (0 for the best)
+  *****/
+typedef struct
+{
+  int   id;
+  float score;
+  float margin;
+  int   count;
+} ScoreResult;
+
+void initScoreQueue(ScoreQueue *queue, int capacity, int number_of_refs);
+void endScoreQueue(ScoreQueue *queue);
 void resetScoreQueue(ScoreQueue *queue);
 void insertInScoreQueue(ScoreQueue *queue, float score, int ref_index);
 
 int getResultID(ScoreQueue *queue);
+int getNBest(ScoreQueue *queue, ScoreResult *nbest, int n);
 
 #endif
 
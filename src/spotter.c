@@ -0,0 +1,391 @@
+/***************************************************************************
+                          spotter.c  -  finds the references of the speaker
+                                        model in a continuous feature stream
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "spotter.h"
+#include "vfr.h"
+
+/********************************************************************************
+ * set up the spotter for the sample utterances of 'model'
+ ********************************************************************************/
+
+void initSpotter( Spotter *sp, Model *model, int sloppy, float threshold, int active_max )
+{
+    int i, k;
+
+    sp->model = model;
+    sp->sloppy = sloppy;
+    sp->threshold = threshold;
+    sp->prune = SPOT_PRUNE * threshold;
+    sp->active_max = active_max;
+
+    sp->samples = ( SpotSample * )malloc( sizeof( SpotSample ) * model->total_number_of_sample_utterances );
+    for( i = 0; i < model->total_number_of_sample_utterances; i++ )
+        for( k = 0; k < 3; k++ )
+        {
+            sp->samples[i].cost[k] = ( float * )malloc( sizeof( float ) * model->direct[i]->length );
+            sp->samples[i].start[k] = ( float * )malloc( sizeof( float ) * model->direct[i]->length );
+        }
+
+    sp->last_frame = ( float * )malloc( sizeof( float ) * VFR_VEC_SIZE );
+    sp->ends = NULL;
+    sp->ends_max = 0;
+    sp->order = ( Detection * )malloc( sizeof( Detection ) * model->total_number_of_sample_utterances );
+    sp->cells = 0;
+
+    resetSpotter( sp );
+}
+
+/********************************************************************************
+ * free the memory of the spotter
+ ********************************************************************************/
+
+void endSpotter( Spotter *sp )
+{
+    int i, k;
+
+    for( i = 0; i < sp->model->total_number_of_sample_utterances; i++ )
+        for( k = 0; k < 3; k++ )
+        {
+            free( sp->samples[i].cost[k] );
+            free( sp->samples[i].start[k] );
+        }
+    free( sp->samples );
+    free( sp->last_frame );
+    free( sp->ends );
+    free( sp->order );
+}
+
+/* drop all paths of a sample */
+
+static void clearSample( SpotSample *s, int length )
+{
+    int k;
+
+    for( k = 0; k < 3; k++ )
+    {
+        s->low[k] = length;
+        s->high[k] = 0;
+    }
+    s->best = FLT_MAX;
+}
+
+/********************************************************************************
+ * start a new stream
+ ********************************************************************************/
+
+void resetSpotter( Spotter *sp )
+{
+    int i;
+
+    for( i = 0; i < sp->model->total_number_of_sample_utterances; i++ )
+        clearSample( &sp->samples[i], sp->model->direct[i]->length );
+
+    sp->column = 0;
+    sp->candidate.id = -1;
+    sp->last_end = 0;
+}
+
+/********************************************************************************
+ * distance of two feature vectors
+ ********************************************************************************/
+
+static float distance( const float *a, const float *b )
+{
+    float result = 0;
+    int i;
+
+    for( i = 0; i < FEAT_VEC_SIZE; i++ )
+        result += ( a[i] - b[i] ) * ( a[i] - b[i] );
+
+    return sqrt( result );
+}
+
+/* accumulated distance in row j of column k, FLT_MAX if no path is there */
+
+static float cell( SpotSample *s, int k, int j )
+{
+    return j >= s->low[k] && j < s->high[k] ? s->cost[k][j] : FLT_MAX;
+}
+
+/* best of the paths into a cell */
+
+typedef struct
+{
+    float cost;
+    float norm;
+    float start;
+} Path;
+
+/* a path with accumulated distance 'cost' that started at 'start' into a cell of normalization 'time' */
+
+static void candidate( Path *best, float cost, float start, float time )
+{
+    float norm = cost / ( time - start );
+
+    if( norm < best->norm )
+    {
+        best->cost = cost;
+        best->norm = norm;
+        best->start = start;
+    }
+}
+
+/********************************************************************************
+ * calculate DTW column 'c' of sample utterance 'index', 'frame' is its
+ * feature vector, 'last_frame' the one before. The best match ending in
+ * this column is entered into 'end'. returns the number of cells calculated.
+ ********************************************************************************/
+
+static int spotColumn( Spotter *sp, int index, long c, float *frame, float *last_frame, Detection *end )
+{
+    SpotSample *s = &sp->samples[index];
+    ModelItemSample *sample = sp->model->direct[index];
+    int k = c % 3, k1 = ( c + 2 ) % 3, k2 = ( c + 1 ) % 3;
+    float *cost = s->cost[k], *start = s->start[k];
+    float *weight = sample->weight, *time = sample->time;
+    float w = frame[VFR_WEIGHT], w_1 = last_frame[VFR_WEIGHT], t = frame[VFR_TIME];
+    int I = sample->length;
+    int bottom, top, low = I, high = 0, cells = 0, j;
+    float act_dist, prev_dist = 0;
+    Path best;
+
+    /*
+     * rows the paths of the last two columns can reach, plus
+     * the bottom rows, at which new paths start
+     */
+    bottom = ( s->low[k1] < s->low[k2] ? s->low[k1] : s->low[k2] ) + 1;
+    top = ( s->high[k1] + 2 > s->high[k2] + 1 ? s->high[k1] + 2 : s->high[k2] + 1 );
+    if( top < sp->sloppy ) top = sp->sloppy;
+    if( top > I ) top = I;
+
+    s->best = FLT_MAX;
+
+    for( j = 0; j < top; j++ )
+    {
+        if( j >= sp->sloppy && j < bottom )
+        {
+            cost[j] = FLT_MAX;
+            continue;
+        }
+
+        act_dist = distance( sample->data[j], frame );
+        cells++;
+
+        best.cost = best.norm = FLT_MAX;
+        best.start = 0;
+
+        /* a new path (open begin), in its first column it may go up the bottom rows */
+
+        if( j == 0 )
+            candidate( &best, ( w + weight[0] ) * act_dist, t - w, t + time[j] );
+        else if( j < sp->sloppy && cost[j - 1] < FLT_MAX && start[j - 1] == t - w )
+            candidate( &best, cost[j - 1] + weight[j] * act_dist, t - w, t + time[j] );
+
+        /* the warping function (see cvoicecontrol.h) */
+
+        if( j >= 1 && cell( s, k1, j - 1 ) < FLT_MAX )
+            candidate( &best, s->cost[k1][j - 1] + ( w + weight[j] ) * act_dist, s->start[k1][j - 1],
+                       t + time[j] );
+
+        if( j >= 2 && cell( s, k1, j - 2 ) < FLT_MAX )
+        {
+            /* the distance of row j-1 is known unless that row has been skipped */
+            if( j - 1 >= sp->sloppy && j - 1 < bottom ) prev_dist = distance( sample->data[j - 1], frame );
+            candidate( &best, s->cost[k1][j - 2] + ( w + weight[j - 1] ) * prev_dist + weight[j] * act_dist,
+                       s->start[k1][j - 2], t + time[j] );
+        }
+
+        if( j >= 1 && cell( s, k2, j - 1 ) < FLT_MAX )
+            candidate( &best, s->cost[k2][j - 1] + ( w_1 + weight[j] ) * distance( sample->data[j], last_frame ) +
+                       w * act_dist, s->start[k2][j - 1], t + time[j] );
+
+        prev_dist = act_dist;
+
+        if( best.norm > sp->prune )
+        {
+            cost[j] = FLT_MAX;
+            continue;
+        }
+
+        cost[j] = best.cost;
+        start[j] = best.start;
+        if( j < low ) low = j;
+        high = j + 1;
+        if( j >= 2 * sp->sloppy && best.norm < s->best ) s->best = best.norm;
+
+        /* the top rows end a match (open end) */
+
+        if( j >= I - sp->sloppy && best.norm < end->score && best.start >= sp->last_end )
+        {
+            end->id = sp->model->direct_map2ref[index];
+            end->sample = index;
+            end->score = best.norm;
+            end->start = best.start;
+            end->end = t;
+        }
+    }
+
+    s->low[k] = low;
+    s->high[k] = high;
+
+    return cells;
+}
+
+/* drop the paths in the last two columns that started before 'time' */
+
+static void dropPaths( Spotter *sp, float time )
+{
+    int i, k, j;
+
+    for( i = 0; i < sp->model->total_number_of_sample_utterances; i++ )
+    {
+        SpotSample *s = &sp->samples[i];
+
+        for( k = ( sp->column + 1 ) % 3; k != sp->column % 3; k = ( k + 1 ) % 3 )
+            for( j = s->low[k]; j < s->high[k]; j++ )
+                if( s->cost[k][j] < FLT_MAX && s->start[k][j] < time )
+                    s->cost[k][j] = FLT_MAX;
+    }
+}
+
+static int compareDetection( const void *a, const void *b )
+{
+    float x = ( ( const Detection * )a )->score, y = ( ( const Detection * )b )->score;
+    return ( x > y ) - ( x < y );
+}
+
+/*
+ * keep paths beyond the rows of the new paths (the bottom rows and as many
+ * above) for the best 'active_max' samples only, cut the others back to them
+ */
+
+static void pruneSamples( Spotter *sp )
+{
+    int i, k, n = 0, fresh = 2 * sp->sloppy;
+    SpotSample *s;
+
+    for( i = 0; i < sp->model->total_number_of_sample_utterances; i++ )
+        if( sp->samples[i].best < FLT_MAX )
+        {
+            sp->order[n].sample = i;
+            sp->order[n].score = sp->samples[i].best;
+            n++;
+        }
+
+    if( n <= sp->active_max ) return;
+
+    qsort( sp->order, n, sizeof( Detection ), compareDetection );
+    for( i = sp->active_max; i < n; i++ )
+    {
+        s = &sp->samples[sp->order[i].sample];
+        for( k = 0; k < 3; k++ )
+            if( s->high[k] > fresh ) s->high[k] = fresh > s->low[k] ? fresh : s->low[k];
+        s->best = FLT_MAX;
+    }
+}
+
+/********************************************************************************
+ * advance all sample utterances by the 'n' merged feature vectors in
+ * 'frames' (VFR_VEC_SIZE values each, see vfr.h). The detections that
+ * are complete are written to 'out' (room for SPOT_DETECTIONS_MAX),
+ * their number is returned.
+ *
+ * Each sample is advanced over the whole batch before the next one is
+ * taken (like in the recognizer), the matches are collected per frame
+ * and gone through in order of time afterwards.
+ ********************************************************************************/
+
+int spotFrames( Spotter *sp, float *frames, int n, Detection *out )
+{
+    float *frame;
+    int i, f, m = 0;
+
+    if( n == 0 ) return 0;
+
+    if( n > sp->ends_max )
+    {
+        sp->ends_max = n;
+        free( sp->ends );
+        sp->ends = ( Detection * )malloc( sizeof( Detection ) * n );
+    }
+    for( f = 0; f < n; f++ )
+    {
+        sp->ends[f].id = -1;
+        sp->ends[f].score = sp->threshold;
+    }
+
+    for( i = 0; i < sp->model->total_number_of_sample_utterances; i++ )
+    {
+        /* samples outside the context (see model.h) start over once they are back in */
+        if( !sp->model->direct[i]->inContext )
+        {
+            clearSample( &sp->samples[i], sp->model->direct[i]->length );
+            continue;
+        }
+
+        for( f = 0; f < n; f++ )
+        {
+            frame = frames + f * VFR_VEC_SIZE;
+            sp->cells += spotColumn( sp, i, sp->column + f, frame, f > 0 ? frame - VFR_VEC_SIZE : sp->last_frame,
+                                     &sp->ends[f] );
+        }
+    }
+
+    sp->column += n;
+    memcpy( sp->last_frame, frames + ( n - 1 ) * VFR_VEC_SIZE, sizeof( float ) * VFR_VEC_SIZE );
+
+    /* the best candidate is reported SPOT_HOLD frames after its end */
+
+    for( f = 0; f < n; f++ )
+    {
+        if( sp->ends[f].id >= 0 && sp->ends[f].start >= sp->last_end &&
+            ( sp->candidate.id < 0 || sp->ends[f].score < sp->candidate.score ) )
+            sp->candidate = sp->ends[f];
+
+        if( sp->candidate.id >= 0 && frames[f * VFR_VEC_SIZE + VFR_TIME] - sp->candidate.end >= SPOT_HOLD )
+        {
+            if( m < SPOT_DETECTIONS_MAX ) out[m++] = sp->candidate;
+            sp->last_end = sp->candidate.end;
+            sp->candidate.id = -1;
+        }
+    }
+
+    if( m > 0 ) dropPaths( sp, sp->last_end );
+    if( sp->active_max > 0 ) pruneSamples( sp );
+
+    return m;
+}
+
+/********************************************************************************
+ * end of the stream: write the pending detection candidate to 'out',
+ * returns 1 if there is one
+ ********************************************************************************/
+
+int spotFlush( Spotter *sp, Detection *out )
+{
+    if( sp->candidate.id < 0 ) return 0;
+
+    *out = sp->candidate;
+    sp->last_end = sp->candidate.end;
+    sp->candidate.id = -1;
+
+    return 1;
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+                          spotter.h  -  finds the references of the speaker
+                                        model in a continuous feature stream
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SPOTTER_H
+#define SPOTTER_H
+
+#include "model.h"
+
+/********************************************************************************
+ * Keyword spotting ('keyword_spotting' = 1): the audio data is not cut into
+ * utterances, the whole stream is one. Each sample utterance is aligned
+ * with any part of it (subsequence DTW): a path may start at the bottom
+ * rows of every column (open begin, see sloppy_corner in cvoicecontrol.h)
+ * and every path that reaches the top rows ends a match (open end). The
+ * warping function is the one of the recognizer, a path is normalized by
+ * the time of the part of the stream it covers plus the time of the sample
+ * rows it has passed. Of the paths into a cell the one with the lowest
+ * normalized distance is kept.
+ *
+ * A match with a score below 'keyword_threshold' is a detection candidate,
+ * it is reported once no better one has been found for SPOT_HOLD frames.
+ * Paths that started before the end of a detection are dropped then.
+ *
+ * The work per frame is bounded by pruning: paths whose normalized distance
+ * exceeds SPOT_PRUNE times the threshold are dropped, so a sample only costs
+ * its first rows (where paths start) until part of the stream matches it.
+ * If 'keyword_active' > 0, at most that many samples keep paths beyond
+ * twice these rows, the ones with the lowest distance there. This is a
+ * beam: too narrow a one loses matches.
+ ********************************************************************************/
+
+#define SPOT_HOLD            20
+#define SPOT_PRUNE           2.0
+#define SPOT_DETECTIONS_MAX  8
+
+extern int   keyword_spotting;
+extern float keyword_threshold;
+extern int   keyword_active;
+
+/********************************************************************************
+ * a match of a sample utterance
+ *
+ * id      reference of the sample, -1 if there is no match
+ * sample  index of the sample utterance (see model.h, 'direct')
+ * score   its normalized distance
+ * start   time (see vfr.h) of the stream before the first matching frame
+ * end     time of the last matching frame
+ ********************************************************************************/
+
+typedef struct
+{
+    int id;
+    int sample;
+    float score;
+    float start;
+    float end;
+} Detection;
+
+/********************************************************************************
+ * state of the DTW of one sample utterance: the last three columns, with
+ * the start time of the path into each cell. Rows outside low .. high-1
+ * of a column hold no path. 'best' is the lowest normalized distance of
+ * the paths beyond twice the bottom rows in the last column.
+ ********************************************************************************/
+
+typedef struct
+{
+    float *cost[3];
+    float *start[3];
+    int low[3];
+    int high[3];
+    float best;
+} SpotSample;
+
+/********************************************************************************
+ * state of the spotter
+ *
+ * model       the speaker model
+ * sloppy      number of bottom rows paths may start at
+ * threshold   detection threshold
+ * prune       paths above this normalized distance are dropped
+ * active_max  most samples with paths beyond the first rows (0: no limit)
+ * samples     DTW state of each sample utterance
+ * column      number of frames (DTW columns) seen so far
+ * last_frame  the last of these frames
+ * ends        per frame of the current batch: best match ending at it
+ * ends_max    room in 'ends'
+ * order       room to sort the samples by their distance
+ * candidate   best detection candidate so far (id -1: none)
+ * last_end    end of the last detection
+ * cells       DTW cells calculated so far (statistics)
+ ********************************************************************************/
+
+typedef struct
+{
+    Model *model;
+    int sloppy;
+    float threshold;
+    float prune;
+    int active_max;
+
+    SpotSample *samples;
+    long column;
+    float *last_frame;
+
+    Detection *ends;
+    int ends_max;
+    Detection *order;
+
+    Detection candidate;
+    float last_end;
+
+    double cells;
+} Spotter;
+
+void initSpotter( Spotter *sp, Model *model, int sloppy, float threshold, int active_max );
+void endSpotter( Spotter *sp );
+void resetSpotter( Spotter *sp );
+
+int  spotFrames( Spotter *sp, float *frames, int n, Detection *out );
+int  spotFlush( Spotter *sp, Detection *out );
+
+#endif
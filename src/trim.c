@@ -0,0 +1,251 @@
+/***************************************************************************
+                          trim.c  -  removes the silence before and after
+                                     an utterance from its feature vectors
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+#include "preprocess.h"
+#include "trim.h"
+
+/********************************************************************************
+ * guard (in ms) and distance of speech from the noise floor (in dB),
+ * both can be set in the configuration file
+ ********************************************************************************/
+
+int   trim_guard = -1;
+float trim_snr = 6;
+
+/*****
+  one unit of the band energies (log2) in dB
+  *****/
+#define LOG2_DB  3.0103
+
+/********************************************************************************
+ * initialize the trimming of utterances
+ ********************************************************************************/
+
+void initTrimmer( Trimmer *trimmer, int guard_ms, float snr )
+{
+    /* guard in 10 ms hops (rounded up) */
+
+    if( guard_ms < 0 )
+        trimmer->guard = -1;
+    else
+    {
+        trimmer->guard = ( MS_TO_BYTES( guard_ms ) + OFFSET - 1 ) / OFFSET;
+        if( trimmer->guard > TRIM_HOLD_MAX ) trimmer->guard = TRIM_HOLD_MAX;
+    }
+
+    trimmer->margin = snr / LOG2_DB;
+    resetTrimmer( trimmer );
+}
+
+/********************************************************************************
+ * start a new utterance, held frames are dropped
+ ********************************************************************************/
+
+void resetTrimmer( Trimmer *trimmer )
+{
+    trimmer->frames = 0;
+    trimmer->speech = 0;
+    trimmer->held_first = 0;
+    trimmer->held_N = 0;
+}
+
+/********************************************************************************
+ * hand out the 'n' oldest held frames to 'out'
+ ********************************************************************************/
+
+static void release( Trimmer *trimmer, float *out, int n )
+{
+    int i;
+
+    for( i = 0; i < n; i++ )
+    {
+        memcpy( out + i * FEAT_VEC_SIZE, trimmer->held[trimmer->held_first], sizeof( float ) * FEAT_VEC_SIZE );
+        trimmer->held_first = ( trimmer->held_first + 1 ) % TRIM_HOLD_MAX;
+    }
+    trimmer->held_N -= n;
+}
+
+/********************************************************************************
+ * hold back a frame (there must be room for it)
+ ********************************************************************************/
+
+static void hold( Trimmer *trimmer, const float *features )
+{
+    memcpy( trimmer->held[( trimmer->held_first + trimmer->held_N ) % TRIM_HOLD_MAX], features,
+            sizeof( float ) * FEAT_VEC_SIZE );
+    trimmer->held_N++;
+}
+
+/********************************************************************************
+ * add the next feature vector of the utterance. The frames that are kept
+ * and can be handed on now are written to 'out' (oldest first, room for
+ * TRIM_HOLD_MAX + 1 vectors is needed), their number is returned.
+ ********************************************************************************/
+
+int trimPush( Trimmer *trimmer, const float *features, float *out )
+{
+    float level = 0;
+    int i, n;
+
+    if( trimmer->guard < 0 )
+    {
+        memcpy( out, features, sizeof( float ) * FEAT_VEC_SIZE );
+        return 1;
+    }
+
+    for( i = 0; i < FEAT_VEC_SIZE; i++ )
+        level += features[i];
+    level /= FEAT_VEC_SIZE;
+
+    if( trimmer->frames == 0 || level < trimmer->floor )
+        trimmer->floor = level;
+    trimmer->frames++;
+
+    if( level >= trimmer->floor + trimmer->margin )
+    {
+        /* speech: the silence held back before it is kept */
+
+        n = trimmer->held_N;
+        release( trimmer, out, n );
+        memcpy( out + n * FEAT_VEC_SIZE, features, sizeof( float ) * FEAT_VEC_SIZE );
+        trimmer->speech = 1;
+        return n + 1;
+    }
+
+    if( !trimmer->speech )
+    {
+        /* leading silence: only the last 'guard' frames may be kept */
+
+        hold( trimmer, features );
+        if( trimmer->held_N > trimmer->guard )
+        {
+            trimmer->held_first = ( trimmer->held_first + 1 ) % TRIM_HOLD_MAX;
+            trimmer->held_N--;
+        }
+        return 0;
+    }
+
+    /* silence after speech: held back as long as there is room */
+
+    n = 0;
+    if( trimmer->held_N == TRIM_HOLD_MAX )
+    {
+        release( trimmer, out, 1 );
+        n = 1;
+    }
+    hold( trimmer, features );
+
+    return n;
+}
+
+/********************************************************************************
+ * end of the utterance: the first 'guard' frames of the trailing silence
+ * are written to 'out', their number is returned. Without any speech,
+ * nothing is kept.
+ ********************************************************************************/
+
+int trimFlush( Trimmer *trimmer, float *out )
+{
+    int n = 0;
+
+    if( trimmer->speech )
+    {
+        n = trimmer->guard < trimmer->held_N ? trimmer->guard : trimmer->held_N;
+        release( trimmer, out, n );
+    }
+
+    resetTrimmer( trimmer );
+    return n;
+}
+
+/********************************************************************************
+ * returns 1 if ending the utterance now keeps the same frames as ending it
+ * after any number of further silent frames
+ ********************************************************************************/
+
+int trimEndKnown( const Trimmer *trimmer )
+{
+    return trimmer->guard >= 0 && trimmer->speech && trimmer->held_N >= trimmer->guard;
+}
+
+/********************************************************************************
+ * write the frames trimFlush() would write now to 'out', without ending
+ * the utterance, and return their number
+ ********************************************************************************/
+
+int trimPeek( const Trimmer *trimmer, float *out )
+{
+    int i, n = 0;
+
+    if( trimmer->speech )
+    {
+        n = trimmer->guard < trimmer->held_N ? trimmer->guard : trimmer->held_N;
+        for( i = 0; i < n; i++ )
+            memcpy( out + i * FEAT_VEC_SIZE, trimmer->held[( trimmer->held_first + i ) % TRIM_HOLD_MAX],
+                    sizeof( float ) * FEAT_VEC_SIZE );
+    }
+
+    return n;
+}
+
+/********************************************************************************
+ * trim the 'length' feature vectors of a whole utterance in place:
+ * the vectors kept replace the first ones in 'data' (the others are
+ * freed). returns the new length. An utterance without any speech, or
+ * one that would be left with fewer than 'min_length' vectors, is left
+ * as it is.
+ ********************************************************************************/
+
+int trimUtterance( int guard_ms, float snr, float **data, int length, int min_length )
+{
+    Trimmer trimmer;
+    float out[( TRIM_HOLD_MAX + 1 ) * FEAT_VEC_SIZE];
+    int i, k, m, n = 0;
+
+    /* count the vectors kept first, the trimming in place can't be undone */
+
+    initTrimmer( &trimmer, guard_ms, snr );
+    for( i = 0; i < length; i++ )
+        n += trimPush( &trimmer, data[i], out );
+    if( !trimmer.speech ) return length;
+    n += trimFlush( &trimmer, out );
+    if( n < min_length ) return length;
+
+    n = 0;
+    initTrimmer( &trimmer, guard_ms, snr );
+
+    /* no more vectors are kept than have been added, so data[n] has always been read */
+
+    for( i = 0; i < length; i++ )
+    {
+        m = trimPush( &trimmer, data[i], out );
+        for( k = 0; k < m; k++, n++ )
+            memcpy( data[n], out + k * FEAT_VEC_SIZE, sizeof( float ) * FEAT_VEC_SIZE );
+    }
+
+    m = trimFlush( &trimmer, out );
+    for( k = 0; k < m; k++, n++ )
+        memcpy( data[n], out + k * FEAT_VEC_SIZE, sizeof( float ) * FEAT_VEC_SIZE );
+
+    for( i = n; i < length; i++ )
+        free( data[i] );
+
+    return n;
+}
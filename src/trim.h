@@ -0,0 +1,89 @@
+/***************************************************************************
+                          trim.h  -  removes the silence before and after
+                                     an utterance from its feature vectors
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TRIM_H
+#define TRIM_H
+
+#include "preprocess.h"
+
+/********************************************************************************
+ * Recorded utterances start with the prefetched audio data and end with
+ * the silence hangover. The level of a frame is the mean of its band
+ * energies, the noise floor is the lowest level seen so far in the
+ * utterance. Frames less than 'trim_snr' dB above the floor are silence:
+ * the ones before the first and after the last speech frame are dropped,
+ * except for 'trim_guard' ms next to the speech.
+ *
+ * The decision only depends on the frames seen so far, so a stream of
+ * frames is trimmed exactly like the same frames at once. Silence after
+ * speech is held back until the next speech frame (or the end of the
+ * utterance), at most TRIM_HOLD_MAX frames of it: if there is more,
+ * the oldest ones are handed out and kept.
+ *
+ * Once 'guard' frames of silence after speech are held, further silence
+ * does not change the frames the utterance ends with: trimPeek() writes
+ * them without ending the utterance (see speculate() in cvoicecontrol.c).
+ *
+ * A negative 'trim_guard' switches trimming off.
+ ********************************************************************************/
+
+#define TRIM_HOLD_MAX  100
+
+/*****
+  guard that keeps weak sounds at the edges of words (in ms)
+  *****/
+#define TRIM_GUARD_MS  50
+
+extern int   trim_guard;
+extern float trim_snr;
+
+/********************************************************************************
+ * state of the trimming of one utterance
+ *
+ * guard      frames kept next to the speech (< 0 = trimming off)
+ * margin     distance of speech from the noise floor (log2 units)
+ * floor      lowest level of the utterance so far
+ * frames     number of frames seen so far
+ * speech     set once the first speech frame has been seen
+ * held       frames held back (a ring buffer)
+ * held_first oldest held frame
+ * held_N     number of held frames
+ ********************************************************************************/
+
+typedef struct
+{
+    int guard;
+    float margin;
+    float floor;
+    int frames;
+    int speech;
+    float held[TRIM_HOLD_MAX][FEAT_VEC_SIZE];
+    int held_first;
+    int held_N;
+} Trimmer;
+
+void initTrimmer( Trimmer *trimmer, int guard_ms, float snr );
+void resetTrimmer( Trimmer *trimmer );
+
+int  trimPush( Trimmer *trimmer, const float *features, float *out );
+int  trimFlush( Trimmer *trimmer, float *out );
+
+int  trimEndKnown( const Trimmer *trimmer );
+int  trimPeek( const Trimmer *trimmer, float *out );
+
+int  trimUtterance( int guard_ms, float snr, float **data, int length, int min_length );
+
+#endif
@@ -0,0 +1,338 @@
+/***************************************************************************
+                          vad.c  -  speech/nonspeech detection
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "audio.h"
+#include "preprocess.h"
+#include "vad.h"
+
+/********************************************************************************
+ * detection method and thresholds of the spectral detection (in dB above
+ * the noise floor), all of them can be set in the configuration file
+ ********************************************************************************/
+
+enum VadMode vad_mode = V_level;
+float speech_snr = 12;
+float silence_snr = 6;
+
+/*****
+  adaptation of the noise floor per hop:
+  the part of the difference to the band energy that the
+  floor moves by, when it falls, when it rises (outside of
+  speech), and when it rises during speech
+  *****/
+#define FLOOR_FALL         0.2
+#define FLOOR_RISE         0.01
+#define FLOOR_RISE_SPEECH  0.001
+
+/*****
+  a hop is no speech if the spectral flatness of its energy above the
+  noise floor (geometric over arithmetic mean of the power per bin of
+  each band) is above this, white noise is close to 1
+  *****/
+#define SPEECH_FLATNESS    0.5
+
+/*****
+  one unit of the band energies (log2) in dB
+  *****/
+#define LOG2_DB            3.0103
+
+/*****
+  number of recordings started by the spectral detector and
+  number of recordings the level detector would have started
+  in addition (i.e. recognition passes avoided)
+  *****/
+static int vad_started = 0;
+static int vad_rejected = 0;
+
+/********************************************************************************
+ * set up a detector using the current vad_mode, 'chunk_size' is the
+ * largest amount of audio data passed in one call, returns 0 on error
+ ********************************************************************************/
+
+int initVad( Vad *vad, int chunk_size )
+{
+    int i, j;
+
+    vad->mode = vad_mode;
+    vad->floor_set = 0;
+
+    if( vad->mode == V_spectral )
+    {
+        if( ( vad->pp = defaultPreprocessor(  ) ) == NULL ) return 0;
+        if( !initFramer( &vad->framer, chunk_size, vad->pp->hamming_window ) ) return 0;
+
+        for( i = 0; i < FEAT_VEC_SIZE; i++ )
+            for( vad->width[i] = 0, j = 0; j < vad->pp->filter_length[i]; j++ )
+                vad->width[i] += vad->pp->filter_weight[vad->pp->filter_offset[i] + j];
+    }
+
+    resetVad( vad );
+    return 1;
+}
+
+/********************************************************************************
+ * start detection from scratch (the noise floor is kept)
+ ********************************************************************************/
+
+void resetVad( Vad *vad )
+{
+    vad->hop_fill = 0;
+    vad->hop_max = 0;
+    vad->count = 0;
+    vad->interrupted = 0;
+
+    if( vad->mode == V_spectral )
+    {
+        resetFramer( &vad->framer );
+        vad->pushed = 0;
+        vad->taken = 0;
+        vad->level_count = 0;
+        vad->level_active = 0;
+    }
+}
+
+/********************************************************************************
+ * free the memory of a detector
+ ********************************************************************************/
+
+void endVad( Vad *vad )
+{
+    if( vad->mode == V_spectral ) endFramer( &vad->framer );
+}
+
+/********************************************************************************
+ * scan 'len' bytes of audio data hop by hop, counting hops in 'count'
+ * (and setting 'interrupted', if not NULL, when a hop breaks the run).
+ * returns the number of bytes up to the end of the hop at which 'hops'
+ * consecutive hops met the condition (peak >= level if 'above' is set,
+ * peak <= level otherwise), or 0 if the condition has not been met yet.
+ ********************************************************************************/
+
+static int scanHops( Vad *vad, const unsigned char *buf, int len, int level, int above,
+                     int hops, int *count, int *interrupted )
+{
+    int i, value, hit;
+
+    for( i = 0; i < len - 1; i += 2 )
+    {
+        value = abs( ( signed short )( buf[i] | ( buf[i + 1] << 8 ) ) );
+        if( value > vad->hop_max ) vad->hop_max = value;
+
+        vad->hop_fill += 2;
+        if( vad->hop_fill < OFFSET ) continue;
+
+        /* a hop is complete: decide */
+
+        hit = above ? vad->hop_max >= level : vad->hop_max <= level;
+        if( hit ) ( *count )++;
+        else
+        {
+            *count = 0;
+            if( interrupted ) *interrupted = 1;
+        }
+
+        vad->hop_fill = 0;
+        vad->hop_max = 0;
+
+        if( *count >= hops ) return i + 2;
+    }
+
+    return 0;
+}
+
+/********************************************************************************
+ * energy of the frame above the energy of the noise floor (log2 units),
+ * and the spectral flatness of the energy above it in 'flatness'.
+ * The noise floor is updated afterwards.
+ ********************************************************************************/
+
+static float aboveFloor( Vad *vad, const float *bands, float *flatness )
+{
+    float energy = 0, floor = 0, snr, diff, rise;
+    float excess, log_sum = 0, sum = 0;
+    int i;
+
+    if( !vad->floor_set )
+    {
+        for( i = 0; i < FEAT_VEC_SIZE; i++ ) vad->floor[i] = bands[i];
+        vad->floor_set = 1;
+    }
+
+    for( i = 0; i < FEAT_VEC_SIZE; i++ )
+    {
+        energy += exp2f( bands[i] );
+        floor += exp2f( vad->floor[i] );
+
+        /* 1 is what the preprocessing adds to every band anyway */
+        excess = ( exp2f( bands[i] ) - exp2f( vad->floor[i] ) ) / vad->width[i];
+        if( excess < 1 ) excess = 1;
+        log_sum += log2f( excess );
+        sum += excess;
+    }
+    snr = log2f( energy / floor );
+    *flatness = exp2f( log_sum / FEAT_VEC_SIZE ) / ( sum / FEAT_VEC_SIZE );
+
+    rise = snr * LOG2_DB >= speech_snr && *flatness <= SPEECH_FLATNESS ? FLOOR_RISE_SPEECH : FLOOR_RISE;
+    for( i = 0; i < FEAT_VEC_SIZE; i++ )
+    {
+        diff = bands[i] - vad->floor[i];
+        vad->floor[i] += ( diff < 0 ? FLOOR_FALL : rise ) * diff;
+    }
+
+    return snr;
+}
+
+/********************************************************************************
+ * take the next frame, pushing as much of the 'len' bytes in 'buf' as it
+ * takes ('done' of them have been pushed already), returns 0 if the audio
+ * data has been used up
+ ********************************************************************************/
+
+static int nextFrame( Vad *vad, float *frame, const unsigned char *buf, int len, int *done )
+{
+    int n;
+
+    while( !framerFrame( &vad->framer, frame ) )
+    {
+        if( *done == len ) return 0;
+
+        n = framerPush( &vad->framer, buf + *done, len - *done );
+        *done += n;
+        vad->pushed += n;
+    }
+    return 1;
+}
+
+/********************************************************************************
+ * scan 'len' bytes of audio data frame by frame (one frame per hop).
+ * returns the number of bytes up to the end of the frame at which 'hops'
+ * consecutive hops met the condition (at least speech_snr dB above the
+ * noise floor if 'speech' is set, at most silence_snr dB otherwise),
+ * or 0 if the condition has not been met yet.
+ ********************************************************************************/
+
+static int scanFrames( Vad *vad, const unsigned char *buf, int len, int speech, int hops )
+{
+    float frames[FRAME_BLOCK * FFT_SIZE];
+    float bands[FRAME_BLOCK * FEAT_VEC_SIZE];
+    unsigned int start = vad->pushed;            /* bytes handed over before 'buf' */
+    int done = 0;
+    int k, n, hit, end;
+    float db, flatness;
+
+    do
+    {
+        for( n = 0; n < FRAME_BLOCK && nextFrame( vad, frames + n * FFT_SIZE, buf, len, &done ); n++ );
+        if( n == 0 ) break;
+
+        /* the band energies are the (raw) feature vectors */
+        preprocessFrames( vad->pp, n, frames, bands );
+
+        for( k = 0; k < n; k++ )
+        {
+            db = aboveFloor( vad, bands + k * FEAT_VEC_SIZE, &flatness ) * LOG2_DB;
+
+            hit = speech ? db >= speech_snr && flatness <= SPEECH_FLATNESS : db <= silence_snr;
+            if( hit ) vad->count++;
+            else
+            {
+                vad->count = 0;
+                vad->interrupted = 1;
+            }
+
+            vad->taken++;
+            if( vad->count >= hops )
+            {
+                /* frame j covers the bytes j*OFFSET .. j*OFFSET+FFT_SIZE_CHAR-1 */
+                end = ( int )( ( vad->taken - 1 ) * OFFSET + FFT_SIZE_CHAR - start );
+                return end > 0 ? end : 1;
+            }
+        }
+    }
+    while( n == FRAME_BLOCK );
+
+    return 0;
+}
+
+/********************************************************************************
+ * look for the start of speech (see above for the return value)
+ ********************************************************************************/
+
+int detectSpeech( Vad *vad, const unsigned char *buf, int len )
+{
+    int n;
+
+    vad->interrupted = 0;
+
+    if( vad->mode == V_level )
+        return scanHops( vad, buf, len, rec_level, 1, speech_onset_hops, &vad->count,
+                         &vad->interrupted );
+
+    /*
+     * the level detector alongside: a recording it would have started
+     * counts as rejected once it would have been stopped again
+     */
+    if( !vad->level_active )
+    {
+        if( scanHops( vad, buf, len, rec_level, 1, speech_onset_hops, &vad->level_count, NULL ) )
+        {
+            vad->level_active = 1;
+            vad->level_count = 0;
+        }
+    }
+    else if( scanHops( vad, buf, len, stop_level, 0, silence_hangover_hops, &vad->level_count,
+                       NULL ) )
+    {
+        vad->level_active = 0;
+        vad->level_count = 0;
+        vad_rejected++;
+    }
+
+    n = scanFrames( vad, buf, len, 1, speech_onset_hops );
+    if( n ) vad_started++;
+
+    return n;
+}
+
+/********************************************************************************
+ * look for the end of speech (see above for the return value)
+ ********************************************************************************/
+
+int detectSilence( Vad *vad, const unsigned char *buf, int len )
+{
+    vad->interrupted = 0;
+
+    if( vad->mode == V_level )
+        return scanHops( vad, buf, len, stop_level, 0, silence_hangover_hops, &vad->count,
+                         &vad->interrupted );
+
+    return scanFrames( vad, buf, len, 0, silence_hangover_hops );
+}
+
+/********************************************************************************
+ * print how many recordings the spectral detection started, and how many
+ * recognition passes (over the whole speaker model) it avoided
+ ********************************************************************************/
+
+void reportVad( FILE *f )
+{
+    if( vad_mode != V_spectral ) return;
+
+    fprintf( f, "voice detection: %d recordings started, %d level triggers rejected (DTW passes avoided)\n",
+             vad_started, vad_rejected );
+}
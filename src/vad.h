@@ -0,0 +1,108 @@
+/***************************************************************************
+                          vad.h  -  speech/nonspeech detection
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdio.h>
+
+#include "preprocess.h"
+#include "framer.h"
+
+/********************************************************************************
+ * speech/nonspeech detection.
+ *
+ * The audio data is cut into hops of OFFSET bytes (10 ms), i.e. the same
+ * framing that is used by the preprocessing. Recording starts after
+ * speech_onset_hops consecutive speech hops and stops after
+ * silence_hangover_hops consecutive silent hops. Hops may span several
+ * blocks of audio data, the detector keeps the partial hop between calls.
+ *
+ * V_level     a hop is 'speech' if its peak value reaches rec_level,
+ *             it is 'silence' if its peak value stays at or below stop_level
+ * V_spectral  each hop is preprocessed like a frame of an utterance, a hop
+ *             is 'speech' if the energy of its bands is at least speech_snr
+ *             dB above that of the noise floor and the energy above the
+ *             floor is not spread evenly over the spectrum (like that of
+ *             a bang), it is 'silence' if the energy is at most silence_snr
+ *             dB above that of the noise floor.
+ *             The noise floor of each band follows the band energy down
+ *             quickly and up slowly (even more slowly during speech), so
+ *             that steady noise (fans etc.) is learned and ignored.
+ *             Short bursts (door slams etc.) rarely last speech_onset_hops.
+ *
+ * In spectral mode the level detector still runs alongside while speech
+ * is looked for: each time it would have started a recording that the
+ * spectral detector did not, a whole recognition pass has been avoided.
+ ********************************************************************************/
+
+enum VadMode
+{
+    V_level,
+    V_spectral
+};
+
+extern enum VadMode vad_mode;
+extern float speech_snr, silence_snr;
+
+/********************************************************************************
+ * state of a detector:
+ *
+ * mode           detection method, vad_mode at the time of initVad()
+ * hop_fill       number of bytes of the current hop seen so far
+ * hop_max        peak value in the current hop
+ * count          number of consecutive hops that met the condition
+ * interrupted    set if a hop did not meet the condition during the last call
+ *
+ * spectral detection only:
+ * pp             context the hops are preprocessed with
+ * framer         cuts the audio data into frames, one per hop
+ * pushed         number of bytes handed to the framer since the last reset
+ * taken          number of frames taken since the last reset
+ * width          number of power spectrum bins summed up by each band
+ * floor          noise floor of each band (log2 of the band energy)
+ * floor_set      set once the noise floor has been initialized
+ * level_count    consecutive hops of the level detector running alongside
+ * level_active   set while the level detector would be recording
+ ********************************************************************************/
+
+typedef struct
+{
+    enum VadMode mode;
+    int hop_fill;
+    int hop_max;
+    int count;
+    int interrupted;
+
+    const Preprocessor *pp;
+    Framer framer;
+    unsigned int pushed;
+    unsigned int taken;
+    float width[FEAT_VEC_SIZE];
+    float floor[FEAT_VEC_SIZE];
+    int floor_set;
+    int level_count;
+    int level_active;
+} Vad;
+
+int  initVad( Vad *vad, int chunk_size );
+void resetVad( Vad *vad );
+void endVad( Vad *vad );
+int  detectSpeech( Vad *vad, const unsigned char *buf, int len );
+int  detectSilence( Vad *vad, const unsigned char *buf, int len );
+
+void reportVad( FILE *f );
+
+#endif
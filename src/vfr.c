@@ -0,0 +1,178 @@
+/***************************************************************************
+                          vfr.c  -  variable frame rate: merges runs of
+                                    similar feature vectors
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfr.h"
+
+/********************************************************************************
+ * merging threshold (euclidean distance of feature vectors),
+ * can be set in the configuration file
+ ********************************************************************************/
+
+float vfr_threshold = 0;
+
+/********************************************************************************
+ * initialize the merging of utterances with the given threshold
+ ********************************************************************************/
+
+void initVfr( Vfr *vfr, float threshold )
+{
+    vfr->threshold = threshold;
+    resetVfr( vfr );
+}
+
+/********************************************************************************
+ * start a new utterance, a pending run is dropped
+ ********************************************************************************/
+
+void resetVfr( Vfr *vfr )
+{
+    vfr->run = 0;
+    vfr->time = 0;
+}
+
+/********************************************************************************
+ * hand out the current run as one merged vector
+ ********************************************************************************/
+
+static void emitRun( Vfr *vfr, float *features, float *weight, float *time )
+{
+    int i;
+
+    for( i = 0; i < FEAT_VEC_SIZE; i++ )
+        features[i] = vfr->run > 1 ? vfr->sum[i] / vfr->run : vfr->sum[i];
+
+    vfr->time += vfr->run;
+    *weight = vfr->run;
+    *time = vfr->time;
+    vfr->run = 0;
+}
+
+/********************************************************************************
+ * add the next frame to the current run. If that ends a run, its merged
+ * vector is written to 'features', 'weight' and 'time' and 1 is returned,
+ * otherwise 0. At most one vector is handed out per frame.
+ ********************************************************************************/
+
+static int addFrame( Vfr *vfr, const float *frame, float *features, float *weight, float *time )
+{
+    float dist = 0;
+    int emitted = 0;
+    int i;
+
+    if( vfr->run > 0 )
+    {
+        for( i = 0; i < FEAT_VEC_SIZE; i++ )
+            dist += ( frame[i] - vfr->first[i] ) * ( frame[i] - vfr->first[i] );
+
+        /* compared squared, this saves the square root per frame */
+
+        if( dist >= vfr->threshold * vfr->threshold )
+        {
+            emitRun( vfr, features, weight, time );
+            emitted = 1;
+        }
+    }
+
+    if( vfr->run == 0 )
+    {
+        memcpy( vfr->first, frame, sizeof( float ) * FEAT_VEC_SIZE );
+        memcpy( vfr->sum, frame, sizeof( float ) * FEAT_VEC_SIZE );
+    }
+    else
+        for( i = 0; i < FEAT_VEC_SIZE; i++ )
+            vfr->sum[i] += frame[i];
+    vfr->run++;
+
+    /* without merging, each frame is handed out at once */
+
+    if( !emitted && ( vfr->threshold <= 0 || vfr->run == VFR_MAX_RUN ) )
+    {
+        emitRun( vfr, features, weight, time );
+        emitted = 1;
+    }
+
+    return emitted;
+}
+
+/********************************************************************************
+ * streaming: add the feature vector 'features', returns the number of
+ * merged vectors (0 or 1) written to 'out' (VFR_VEC_SIZE values)
+ ********************************************************************************/
+
+int vfrPush( Vfr *vfr, const float *features, float *out )
+{
+    return addFrame( vfr, features, out, out + VFR_WEIGHT, out + VFR_TIME );
+}
+
+/********************************************************************************
+ * end of the utterance: hand out the pending run, returns the number
+ * of merged vectors (0 or 1) written to 'out'
+ ********************************************************************************/
+
+int vfrFlush( Vfr *vfr, float *out )
+{
+    if( vfr->run == 0 ) return 0;
+
+    emitRun( vfr, out, out + VFR_WEIGHT, out + VFR_TIME );
+    return 1;
+}
+
+/********************************************************************************
+ * merge the 'length' feature vectors of a whole utterance in place:
+ * the merged vectors replace the first ones in 'data' (the others are
+ * freed), their weights and times are stored in 'weight' and 'time'
+ * (at least 'length' values each). returns the new length. An utterance
+ * that would be left with fewer than 'min_length' vectors is left as it is.
+ ********************************************************************************/
+
+int vfrCompress( float threshold, float **data, int length, float *weight, float *time, int min_length )
+{
+    Vfr vfr;
+    float out[VFR_VEC_SIZE];
+    int i, n = 0;
+
+    /* count the merged vectors first, the merging in place can't be undone */
+
+    initVfr( &vfr, threshold );
+    for( i = 0; i < length; i++ )
+        n += vfrPush( &vfr, data[i], out );
+    n += vfrFlush( &vfr, out );
+    if( n < min_length ) return length;
+
+    n = 0;
+    initVfr( &vfr, threshold );
+
+    /*
+     * a merged vector is handed out while its last frame is added, or later,
+     * so data[n] has always been read when it is overwritten
+     */
+    for( i = 0; i < length; i++ )
+        n += addFrame( &vfr, data[i], data[n], weight + n, time + n );
+
+    if( vfr.run > 0 )
+    {
+        emitRun( &vfr, data[n], weight + n, time + n );
+        n++;
+    }
+
+    for( i = n; i < length; i++ )
+        free( data[i] );
+
+    return n;
+}
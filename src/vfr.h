@@ -0,0 +1,74 @@
+/***************************************************************************
+                          vfr.h  -  variable frame rate: merges runs of
+                                    similar feature vectors
+                             -------------------
+    begin                : Mon Oct 19 2026
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef VFR_H
+#define VFR_H
+
+#include "preprocess.h"
+
+/********************************************************************************
+ * Steady parts of an utterance (vowels, the silence before and after it)
+ * produce long runs of nearly identical feature vectors. Each run is
+ * replaced by the mean of its vectors and a duration weight, the number
+ * of 10 ms frames it stands for. A run ends at the first frame whose
+ * distance to the first frame of the run reaches 'vfr_threshold', or
+ * after VFR_MAX_RUN frames, which bounds the delay the merging adds.
+ *
+ * A merged vector handed to the recognizer has VFR_VEC_SIZE values:
+ * the FEAT_VEC_SIZE features, its weight (VFR_WEIGHT) and its time
+ * (VFR_TIME), the sum of the weights of the utterance up to and
+ * including this vector. Sample utterances of the speaker model keep
+ * weight and time in arrays of their own.
+ *
+ * A threshold of 0 switches merging off, every frame gets weight 1.
+ ********************************************************************************/
+
+#define VFR_WEIGHT    FEAT_VEC_SIZE
+#define VFR_TIME      (FEAT_VEC_SIZE + 1)
+#define VFR_VEC_SIZE  (FEAT_VEC_SIZE + 2)
+
+#define VFR_MAX_RUN   8
+
+extern float vfr_threshold;
+
+/********************************************************************************
+ * state of the merging of one utterance
+ *
+ * threshold  distance at which a frame starts a new run (0 = off)
+ * first      first frame of the current run
+ * sum        sum of the frames of the current run
+ * run        number of frames in the current run
+ * time       sum of the weights handed out so far
+ ********************************************************************************/
+
+typedef struct
+{
+    float threshold;
+    float first[FEAT_VEC_SIZE];
+    float sum[FEAT_VEC_SIZE];
+    int run;
+    float time;
+} Vfr;
+
+void initVfr( Vfr *vfr, float threshold );
+void resetVfr( Vfr *vfr );
+
+int  vfrPush( Vfr *vfr, const float *features, float *out );
+int  vfrFlush( Vfr *vfr, float *out );
+
+int  vfrCompress( float threshold, float **data, int length, float *weight, float *time, int min_length );
+
+#endif